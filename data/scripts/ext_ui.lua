@@ -42,7 +42,7 @@ function set(m, v)
     else
         title.gui_text.text = "Unknown " .. v.type
     end
-    assign_button.gui_rect.enabled = v.build_progress < 1 and v.builder == -1
+    assign_button.gui_rect.enabled = (v.build_progress < 1 or v.broken) and v.builder == -1
     build_progress.gui_rect.enabled = v.builder ~= -1
     assign_button.lua_script[0].onButtonClicked = function()
         local env = _G.module_ui.lua_script[0]
@@ -55,15 +55,37 @@ function set(m, v)
     end
 end
 
-function update()
+-- broken extensions are repaired by assigning a builder, like building them
+local function getMaintenanceTask(id)
+    for _, task in ipairs(Game.getMaintenanceTasks()) do
+        if task.id == id then return task end
+    end
+    return nil
+end
+
+local function refresh()
     if module == nil then return end
 
+    local task = getMaintenanceTask(extension.id)
+    if task ~= nil then
+        build_progress.gui_rect.enabled = task.builder ~= -1
+        build_progress.gui_rect.right_relative = math.max(0, task.repair_progress)
+        assign_button.gui_rect.enabled = task.builder == -1
+        return
+    end
+
     local ext = getExtensionByID(module.entity, extension.id)
     build_progress.gui_rect.enabled = ext.builder ~= -1
     local p = ext.build_progress
-    if p >= 1 then return end
+    if p >= 1 then
+        assign_button.gui_rect.enabled = false
+        return
+    end
     
     build_progress.gui_rect.right_relative = math.max(0, p)
     assign_button.gui_rect.enabled = ext.builder == -1 and p < 1
 end
 
+function start()
+    Game.scheduleUpdate(this, "ext_ui", refresh, { ms = 100 })
+end
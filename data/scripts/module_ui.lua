@@ -51,15 +51,13 @@ function ui_rect(v)
     ui_rect.top_points = v.top_points or 0
     ui_rect.top_relative = v.top_relative or 0
     
+    -- scheduled by the game, every frame unless the rect asks for update_ms or update_frames
     if v.update ~= nil then
-        local s = e:createComponent("lua_script")
-        local lua_scene = LumixAPI.getModule(this._world, "lua_script")
-        LuaScript.addScript(lua_scene, e, 0)
-        local evt = e.lua_script[0]
-        evt.update = function()
+        local rate = { frames = v.update_frames or 1 }
+        if v.update_ms ~= nil then rate = { ms = v.update_ms } end
+        Game.scheduleUpdate(e, v.update_name or "ui_rect", function()
             v.update(e)
-        end
-        LuaScript.rescan(this._world, e, 0)
+        end, rate)
     end
 
     for i = #v, 1, -1 do
@@ -224,38 +222,43 @@ function enable_assign_pane(module, extension)
 
     destroyChildren(assign_list)
 
-    for i, c in ipairs(crew) do
-        row = math.floor((i - 1) / 3)
-        col = math.floor((i - 1) % 3)
-        ui_button {
-            color = {1, 1, 1, 0.5},
-            top_points = row * 50,
-            bottom_points = row * 50 + 45,
-            top_relative = 0,
-            bottom_relative = 0,
-            parent = assign_list,
-            left_relative = col * 0.333,
-            right_relative = col * 0.333 + 0.333,
-            left_points = 5,
-            on_click = function()
-                slide_out_pane(assign_pane)
-                if extension ~= nil then
-                    refresh = module.entity
-                    Game.assignBuilder(extension.id, c.id)
-                    slide_in_pane(default_pane)
-                else
-                    refresh = module.entity
-                    Game.assignBuilder(module.id, c.id)
-                    slide_in_pane(build_module_pane)
-                end
-            end,
-            ui_text {
-                text = c.name,
-                font_size = 20,
-                vertical_align = 1,
-                horizontal_align = 1
+    -- crew away on an expedition can not be assigned
+    local i = 0
+    for _, c in ipairs(crew) do
+        if c.state ~= "expedition" then
+            row = math.floor(i / 3)
+            col = i % 3
+            ui_button {
+                color = {1, 1, 1, 0.5},
+                top_points = row * 50,
+                bottom_points = row * 50 + 45,
+                top_relative = 0,
+                bottom_relative = 0,
+                parent = assign_list,
+                left_relative = col * 0.333,
+                right_relative = col * 0.333 + 0.333,
+                left_points = 5,
+                on_click = function()
+                    slide_out_pane(assign_pane)
+                    if extension ~= nil then
+                        refresh = module.entity
+                        Game.assignBuilder(extension.id, c.id)
+                        slide_in_pane(default_pane)
+                    else
+                        refresh = module.entity
+                        Game.assignBuilder(module.id, c.id)
+                        slide_in_pane(build_module_pane)
+                    end
+                end,
+                ui_text {
+                    text = c.name,
+                    font_size = 20,
+                    vertical_align = 1,
+                    horizontal_align = 1
+                }
             }
-        }
+            i = i + 1
+        end
     end
 
 end
@@ -320,7 +323,7 @@ function update_build_progress()
     end
 end
 
-function update()
+local function tick()
     if refresh ~= -1 then
         setModule({_entity = refresh})
         refresh = -1
@@ -349,6 +352,7 @@ function getFreeSpace(module)
 end
 
 function start()
+    Game.scheduleUpdate(this, "module_ui", tick, { frames = 2 })
     build_ext_pane.gui_rect.enabled = false
     assign_pane.gui_rect.enabled = false
     build_ext_pane_back.lua_script[0].onButtonClicked = function()
@@ -15,15 +15,7 @@ local air_ui = 0
 local water_ui = 0
 local food_ui = 0
 
-function start()
-    power_ui = power.gui_text
-    heat_ui = heat.gui_text
-    air_ui = air.gui_text
-    water_ui = water.gui_text
-    food_ui = food.gui_text
-end
-
-function update()
+local function refresh()
     local s = Game.getStationStats()
     power_ui.text = tostring(s.power_prod - s.power_cons) .. " kJ/s"
     heat_ui.text = tostring(s.heat_prod - s.heat_cons) .. " kJ/s"
@@ -31,3 +23,12 @@ function update()
     water_ui.text = tostring(s.water_prod - s.water_cons) .. " l/day"
     food_ui.text = tostring(s.food_prod - s.food_cons) .. " kcal/day"
 end
+
+function start()
+    power_ui = power.gui_text
+    heat_ui = heat.gui_text
+    air_ui = air.gui_text
+    water_ui = water.gui_text
+    food_ui = food.gui_text
+    Game.scheduleUpdate(this, "quick_stats_ui", refresh, { ms = 250 })
+end
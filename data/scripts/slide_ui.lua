@@ -12,7 +12,7 @@ function startSlide(from, to)
     rect.right_relative = from + 1
 end
 
-function update(td)
+local function slide(td)
     if t >= 0 then
         t = t + td * 3
         if t > 1 then
@@ -25,4 +25,9 @@ function update(td)
         rect.left_relative = x
         rect.right_relative = x + 1
     end
-end
\ No newline at end of file
+end
+
+-- every frame, the slide is an animation
+function start()
+    Game.scheduleUpdate(this, "slide_ui", slide, { frames = 1 })
+end
@@ -6,16 +6,17 @@ for _, p in ipairs(props) do
     Editor.setPropertyType(this, p, Editor.ENTITY_PROPERTY)
 end
 
+local function refresh()
+    local s = Game.getStationStats()
+    for i, v in ipairs(props) do
+        _ENV[v .. "_ui"].text = tostring(s[v.. "_prod"] - s[v .. "_cons"]) .. " " .. units[i] .. " (" .. tostring(s[v.. "_prod"]) .. " - " .. tostring(s[v.. "_cons"]) .. ")"
+    end
+end
+
 function start()
     for _, p in ipairs(props) do
         local s = Lumix.Entity:new(this._world, _ENV[p])
         _ENV[p .. "_ui"] = s:getComponent("gui_text") 
     end
-end
-
-function update()
-    local s = Game.getStationStats()
-    for i, v in ipairs(props) do
-        _ENV[v .. "_ui"].text = tostring(s[v.. "_prod"] - s[v .. "_cons"]) .. " " .. units[i] .. " (" .. tostring(s[v.. "_prod"]) .. " - " .. tostring(s[v.. "_cons"]) .. ")"
-    end
+    Game.scheduleUpdate(this, "stats_ui", refresh, { ms = 500 })
 end
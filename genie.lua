@@ -4,6 +4,17 @@ newoption {
 	description = "Build DLL version"
 }
 
+newoption {
+	trigger = "benchmark",
+	description = "Run the benchmark suite on generated stations when the game starts"
+}
+
+function benchmarkDefines()
+	if _OPTIONS["benchmark"] then
+		defines { "SPACE_GAME_BENCHMARK" }
+	end
+end
+
 if _OPTIONS["dll"] then
 	function copyPDA(config)
 		configuration { config }
@@ -28,6 +39,7 @@ if _OPTIONS["dll"] then
 
 		includedirs { "src", }
 		defines { "BUILDING_GAME" }
+		benchmarkDefines()
 		useLua()
 		defaultConfigurations()
 
@@ -43,6 +55,7 @@ else
 		"genie.lua"
 	}
 	defines { "BUILDING_SPACE_GAME" }
+	benchmarkDefines()
 	links { "engine" }
 	useLua()
 
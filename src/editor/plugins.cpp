@@ -1,6 +1,100 @@
 #include "editor/studio_app.h"
+#include "engine/allocator.h"
+#include "engine/engine.h"
+#include "engine/file_system.h"
+#include "engine/log.h"
+#include "engine/os.h"
+#include "engine/prefab.h"
+#include "engine/resource_manager.h"
+#include "engine/world.h"
+#include "../prefab_pins.h"
+
+using namespace Lumix;
+
+// Keeps the station prefabs loaded and bakes their `.pins` sidecar each time one of them (re)loads,
+// i.e. when the editor starts and after every save of the prefab. Broken prefabs are reported right away
+// instead of when the game tries to attach something to them.
+struct PinBakerPlugin : StudioApp::IPlugin {
+	PinBakerPlugin(StudioApp& app)
+		: m_app(app)
+		, m_prefabs(app.getAllocator())
+	{}
+
+	~PinBakerPlugin() {
+		for (PrefabResource* prefab : m_prefabs) {
+			prefab->getObserverCb().unbind<&PinBakerPlugin::onStateChanged>(this);
+			prefab->decRefCount();
+		}
+	}
+
+	const char* getName() const override { return "game"; }
+
+	void init() override {
+		Engine& engine = m_app.getEngine();
+		const StaticString<MAX_PATH> dir(engine.getFileSystem().getBasePath(), "prefabs");
+		os::FileIterator* iter = os::createFileIterator(dir.data, m_app.getAllocator());
+		if (!iter) return;
+
+		os::FileInfo info;
+		while (os::getNextFile(iter, &info)) {
+			if (info.is_directory) continue;
+			if (!isStationPrefab(info.filename)) continue;
+
+			PrefabResource* prefab = engine.getResourceManager().load<PrefabResource>(Path("prefabs/", info.filename));
+			prefab->getObserverCb().bind<&PinBakerPlugin::onStateChanged>(this);
+			m_prefabs.push(prefab);
+		}
+		os::destroyFileIterator(iter);
+	}
+
+	static bool isStationPrefab(const char* filename) {
+		if (!equalStrings(Path::getExtension(filename), "fab")) return false;
+		return startsWith(filename, "module_") || equalStrings(filename, "solar_panel.fab");
+	}
+
+	void onStateChanged(Resource::State, Resource::State new_state, Resource& resource) {
+		if (new_state != Resource::State::READY) return;
+		bake((PrefabResource&)resource);
+	}
+
+	void bake(PrefabResource& prefab) {
+		Engine& engine = m_app.getEngine();
+		const char* path = prefab.getPath().c_str();
+
+		// pins are read from an instance in a scratch world, the same way the game sees them
+		World& world = engine.createWorld(false);
+		EntityMap entity_map(m_app.getAllocator());
+		PrefabPins pins;
+		bool valid = false;
+		if (engine.instantiatePrefab(world, prefab, DVec3(0), Quat::IDENTITY, Vec3(1), entity_map)) {
+			pins.scan(world, (EntityRef)entity_map.m_map[0]);
+			valid = pins.validate(path);
+		}
+		else logError("Failed to instantiate ", path);
+		engine.destroyWorld(world);
+
+		// a stale sidecar would be worse than none, the game falls back to scanning names without it
+		const Path sidecar(path, ".pins");
+		if (!valid) {
+			const StaticString<MAX_PATH> full_path(engine.getFileSystem().getBasePath(), sidecar.c_str());
+			if (os::fileExists(full_path.data)) os::deleteFile(full_path.data);
+			return;
+		}
+
+		OutputMemoryStream blob(m_app.getAllocator());
+		pins.serialize(blob);
+		if (!engine.getFileSystem().saveContentSync(sidecar, Span(blob.data(), (u32)blob.size()))) {
+			logError("Failed to write ", sidecar);
+			return;
+		}
+		logInfo("Baked ", pins.count, " pins of ", path);
+	}
+
+	StudioApp& m_app;
+	Array<PrefabResource*> m_prefabs;
+};
 
 LUMIX_STUDIO_ENTRY(game_plugin)
 {
-	return nullptr;
-}
\ No newline at end of file
+	return LUMIX_NEW(app.getAllocator(), PinBakerPlugin)(app);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "engine/log.h"
+#include "engine/stream.h"
+#include "engine/string.h"
+#include "engine/world.h"
+
+namespace Lumix {
+
+// Pins are the direct children of a station prefab's root that other parts attach to, recognized by name:
+// `hatch_N` connects two modules, `ext_N` holds an extension with a prefab.
+// The editor bakes them into a `<prefab>.pins` sidecar whenever the prefab is saved, so the game
+// reads kinds, transforms and connection rules from there instead of scanning entity names.
+struct PrefabPin {
+	enum class Kind : u8 {
+		HATCH,
+		EXT
+	};
+
+	enum Accepts : u8 {
+		MODULE = 1 << 0,
+		EXTENSION = 1 << 1
+	};
+
+	StaticString<16> name;
+	Kind kind;
+	u8 accepts; // Accepts
+	bool attach; // the hatch a new module is attached by, `hatch_0`
+	Vec3 pos; // relative to the prefab root
+	Quat rot;
+
+	Transform getLocalTransform() const { return Transform(DVec3(pos), rot, Vec3(1)); }
+};
+
+struct PrefabPins {
+	static constexpr u32 MAGIC = 0x50494e53; // 'PINS'
+	static constexpr u32 VERSION = 0;
+	static constexpr u32 MAX_PINS = 16;
+
+	// what the game expects from a prefab, derived from its file name
+	enum class Role : u8 {
+		MODULE, // module_*.fab
+		EXTENSION, // anything else, e.g. solar_panel.fab
+	};
+
+	static Role getRole(const char* prefab_path) {
+		const char* basename = prefab_path;
+		for (const char* c = prefab_path; *c; ++c) {
+			if (*c == '/' || *c == '\\') basename = c + 1;
+		}
+		return startsWith(basename, "module_") ? Role::MODULE : Role::EXTENSION;
+	}
+
+	static bool getKind(const char* name, PrefabPin::Kind& kind) {
+		if (startsWith(name, "hatch_")) kind = PrefabPin::Kind::HATCH;
+		else if (startsWith(name, "ext_")) kind = PrefabPin::Kind::EXT;
+		else return false;
+		return true;
+	}
+
+	// collects pins from an instance of the prefab, `root` is the instance's root
+	void scan(const World& world, EntityRef root) {
+		count = 0;
+		overflow = 0;
+		for (EntityRef ch : world.childrenOf(root)) {
+			const char* name = world.getEntityName(ch);
+			PrefabPin::Kind kind;
+			if (!getKind(name, kind)) continue;
+			if (count == MAX_PINS) {
+				++overflow;
+				continue;
+			}
+
+			const Transform tr = world.getLocalTransform(ch);
+			PrefabPin& pin = pins[count];
+			pin.name = name;
+			pin.kind = kind;
+			pin.accepts = kind == PrefabPin::Kind::HATCH ? PrefabPin::MODULE : PrefabPin::EXTENSION;
+			pin.attach = equalStrings(name, "hatch_0");
+			pin.pos = Vec3(tr.pos);
+			pin.rot = tr.rot;
+			pin_scales[count] = tr.scale;
+			++count;
+		}
+	}
+
+	// logs everything the game would trip over, call right after `scan`
+	bool validate(const char* prefab_path) const {
+		bool valid = true;
+		if (overflow > 0) {
+			logError(prefab_path, ": ", count + overflow, " pins, only ", MAX_PINS, " are supported");
+			valid = false;
+		}
+
+		u32 hatches = 0;
+		for (u32 i = 0; i < count; ++i) {
+			const PrefabPin& pin = pins[i];
+			if (pin.kind == PrefabPin::Kind::HATCH) ++hatches;
+			if (pin.name.data[pin.kind == PrefabPin::Kind::HATCH ? 6 : 4] == '\0') {
+				logError(prefab_path, ": pin ", pin.name.data, " has no index");
+				valid = false;
+			}
+			const Vec3 scale = pin_scales[i];
+			if (scale.x != 1 || scale.y != 1 || scale.z != 1) {
+				logError(prefab_path, ": pin ", pin.name.data, " is scaled, attached parts would be distorted");
+				valid = false;
+			}
+			for (u32 j = 0; j < i; ++j) {
+				if (equalStrings(pins[j].name, pin.name)) {
+					logError(prefab_path, ": pin ", pin.name.data, " is there more than once");
+					valid = false;
+				}
+			}
+		}
+
+		switch (getRole(prefab_path)) {
+			case Role::MODULE:
+				if (!find("hatch_0")) {
+					logError(prefab_path, ": missing pin hatch_0, the module can not be attached to the station");
+					valid = false;
+				}
+				if (hatches < 2) logWarning(prefab_path, ": only one hatch, nothing can be attached to this module");
+				break;
+			case Role::EXTENSION:
+				if (count > 0) {
+					logError(prefab_path, ": extensions are attached by their root and can not have pins");
+					valid = false;
+				}
+				break;
+		}
+		return valid;
+	}
+
+	const PrefabPin* find(const char* name) const {
+		for (u32 i = 0; i < count; ++i) {
+			if (equalStrings(pins[i].name, name)) return &pins[i];
+		}
+		return nullptr;
+	}
+
+	const PrefabPin* getAttachHatch() const {
+		for (u32 i = 0; i < count; ++i) {
+			if (pins[i].attach) return &pins[i];
+		}
+		return nullptr;
+	}
+
+	const PrefabPin* begin() const { return pins; }
+	const PrefabPin* end() const { return pins + count; }
+
+	void serialize(OutputMemoryStream& blob) const {
+		blob.write(MAGIC);
+		blob.write(VERSION);
+		blob.write(count);
+		blob.write(pins, sizeof(pins[0]) * count);
+	}
+
+	bool deserialize(InputMemoryStream& blob) {
+		count = 0;
+		if (blob.read<u32>() != MAGIC) return false;
+		if (blob.read<u32>() != VERSION) return false;
+		const u32 c = blob.read<u32>();
+		if (blob.hasOverflow() || c > MAX_PINS) return false;
+		blob.read(pins, sizeof(pins[0]) * c);
+		if (blob.hasOverflow()) return false;
+		count = c;
+		return true;
+	}
+
+	PrefabPin pins[MAX_PINS];
+	u32 count = 0;
+
+private:
+	// only known while scanning, not baked
+	Vec3 pin_scales[MAX_PINS];
+	u32 overflow = 0;
+};
+
+} // namespace Lumix
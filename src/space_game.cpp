@@ -1,19 +1,28 @@
+#include "engine/atomic.h"
 #include "engine/engine.h"
+#include "engine/file_system.h"
 #include "engine/input_system.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
+#include "engine/os.h"
 #include "engine/lua_wrapper.h"
 #include "engine/plugin.h"
 #include "engine/prefab.h"
 #include "engine/profiler.h"
 #include "engine/reflection.h"
+#include "engine/simd.h"
 #include "engine/resource_manager.h"
+#include "engine/sync.h"
+#include "engine/thread.h"
 #include "engine/world.h"
 #include "gui/gui_module.h"
 #include "gui/gui_system.h"
 #include "lua_script/lua_script_system.h"
 #include "renderer/model.h"
 #include "renderer/render_module.h"
+#include "prefab_pins.h"
 #include <cstdio>
+#include <cstdlib>
 
 using namespace Lumix;
 
@@ -21,27 +30,567 @@ static const ComponentType MODEL_INSTANCE_TYPE = reflection::getComponentType("m
 static const ComponentType LUA_SCRIPT_TYPE = reflection::getComponentType("lua_script");
 static const ComponentType GUI_BUTTON_TYPE = reflection::getComponentType("gui_button");
 
+// Prefabs listed in the manifest, loaded asynchronously in priority order with a limited number of loads in flight.
+// Code using an asset checks its readiness or waits for it with `whenReady`.
+// Pins of a prefab come from its `.pins` sidecar, baked by the editor, read once the prefab is ready.
+struct Assets {
+	enum ID : u32 {
+		MODULE_2,
+		MODULE_3,
+		SOLAR_PANEL,
+
+		COUNT,
+		NONE = COUNT
+	};
+
+	enum class Priority : u8 {
+		CRITICAL, // needed to start the game, requested immediately
+		HIGH,
+		LOW
+	};
+
+	struct ManifestEntry {
+		const char* path;
+		Priority priority;
+	};
+
+	static constexpr ManifestEntry MANIFEST[] = {
+		{ "prefabs/module_2.fab", Priority::CRITICAL },
+		{ "prefabs/module_3.fab", Priority::HIGH },
+		{ "prefabs/solar_panel.fab", Priority::CRITICAL },
+		// prefabs/module_4.fab does not exist yet
+	};
+	static_assert(lengthOf(MANIFEST) == COUNT);
+
+	static constexpr u32 MAX_IN_FLIGHT = 2; // for non-critical assets
+
+	struct ReadyCallback {
+		ID asset; // NONE waits for all critical assets
+		void* owner;
+		Delegate<void()> callback;
+	};
+
+	Assets(ResourceManagerHub& rm, FileSystem& fs, IAllocator& allocator)
+		: m_resource_manager(rm)
+		, m_file_system(fs)
+		, m_callbacks(allocator)
+	{
+		for (u32 i = 0; i < COUNT; ++i) {
+			m_priority[i] = MANIFEST[i].priority;
+			m_pins_reads[i].assets = this;
+			m_pins_reads[i].id = (ID)i;
+		}
+	}
+
+	~Assets() {
+		for (const PinsRead& read : m_pins_reads) {
+			if (read.handle.isValid()) m_file_system.cancel(read.handle);
+		}
+		for (PrefabResource* prefab : m_prefabs) {
+			if (prefab) prefab->decRefCount();
+		}
+	}
+
+	bool isReady(ID id) const { return id < COUNT && m_ready[id] != 0; }
+	bool isFailure(ID id) const { return id < COUNT && m_failed[id]; }
+	
+	// nullptr until the asset is ready
+	PrefabResource* get(ID id) const { return isReady(id) ? m_prefabs[id] : nullptr; }
+
+	// nullptr if the asset is not ready or has no usable sidecar, see `setPins`
+	const PrefabPins* getPins(ID id) const { return id < COUNT && m_has_pins[id] ? &m_pins[id] : nullptr; }
+
+	// fallback for prefabs without a baked sidecar, pins scanned from an instance
+	void setPins(ID id, const PrefabPins& pins) {
+		m_pins[id] = pins;
+		m_has_pins[id] = true;
+	}
+
+	bool areCriticalReady() const {
+		for (u32 i = 0; i < COUNT; ++i) {
+			if (MANIFEST[i].priority == Priority::CRITICAL && !isReady((ID)i)) return false;
+		}
+		return true;
+	}
+
+	bool hasCriticalFailure() const {
+		for (u32 i = 0; i < COUNT; ++i) {
+			if (MANIFEST[i].priority == Priority::CRITICAL && isFailure((ID)i)) return true;
+		}
+		return false;
+	}
+
+	// someone is waiting for the asset, load it before anything else
+	void request(ID id) {
+		if (id >= COUNT || m_prefabs[id]) return;
+		m_priority[id] = Priority::CRITICAL;
+		load(id);
+	}
+
+	// `callback` is called from `update` once `asset` is ready, or right away if it's ready already.
+	// If the asset fails to load, the callback is dropped and the failure is logged.
+	void whenReady(ID asset, void* owner, const Delegate<void()>& callback) {
+		if (asset == NONE ? areCriticalReady() : isReady(asset)) {
+			callback.invoke();
+			return;
+		}
+		if (asset == NONE ? hasCriticalFailure() : isFailure(asset)) {
+			logError(asset == NONE ? "Critical assets" : MANIFEST[asset].path, " failed to load, waiting for them is pointless");
+			return;
+		}
+		if (asset != NONE) request(asset);
+		m_callbacks.push({asset, owner, callback});
+	}
+
+	void cancelCallbacks(void* owner) {
+		for (i32 i = m_callbacks.size() - 1; i >= 0; --i) {
+			if (m_callbacks[i].owner == owner) m_callbacks.erase(i);
+		}
+	}
+
+	void update() {
+		PROFILE_FUNCTION();
+		const u64 now = os::Timer::getRawTimestamp();
+
+		u32 in_flight = 0;
+		for (u32 i = 0; i < COUNT; ++i) {
+			if (!m_prefabs[i] || m_ready[i] || m_failed[i]) continue;
+			if (m_pins_reads[i].pending) ++in_flight;
+			else if (m_prefabs[i]->isReady()) {
+				// the asset is ready once its pins are read too, see onPinsRead
+				loadPins((ID)i);
+				++in_flight;
+			}
+			else if (m_prefabs[i]->isFailure()) {
+				m_failed[i] = true;
+				logError("Failed to load ", MANIFEST[i].path);
+			}
+			else ++in_flight;
+		}
+
+		for (u32 p = (u32)Priority::CRITICAL; p <= (u32)Priority::LOW; ++p) {
+			for (u32 i = 0; i < COUNT; ++i) {
+				if (m_prefabs[i] || m_priority[i] != (Priority)p) continue;
+				if ((Priority)p != Priority::CRITICAL && in_flight >= MAX_IN_FLIGHT) break;
+				load((ID)i);
+				++in_flight;
+			}
+		}
+
+		for (i32 i = 0; i < m_callbacks.size(); ++i) {
+			const ReadyCallback& cb = m_callbacks[i];
+			const bool ready = cb.asset == NONE ? areCriticalReady() : isReady(cb.asset);
+			const bool failed = cb.asset == NONE ? hasCriticalFailure() : isFailure(cb.asset);
+			if (!ready && !failed) continue;
+
+			const Delegate<void()> callback = cb.callback;
+			m_callbacks.erase(i);
+			--i;
+			if (ready) callback.invoke();
+			else logError(cb.asset == NONE ? "Critical assets" : MANIFEST[cb.asset].path, " failed to load, the code waiting for them does not run");
+		}
+
+		if (!m_critical_path_reported && areCriticalReady()) {
+			m_critical_path_reported = true;
+			reportCriticalPath(now);
+		}
+	}
+
+	PrefabResource* m_prefabs[COUNT] = {};
+	
+private:
+	void load(ID id) {
+		ASSERT(!m_prefabs[id]);
+		m_prefabs[id] = m_resource_manager.load<PrefabResource>(Path(MANIFEST[id].path));
+		m_requested[id] = os::Timer::getRawTimestamp();
+	}
+
+	// the sidecar of each prefab is read asynchronously, the callback needs to know which one it got
+	struct PinsRead {
+		Assets* assets;
+		ID id;
+		bool pending = false;
+		FileSystem::AsyncHandle handle = FileSystem::AsyncHandle::invalid();
+
+		void onLoaded(Span<const u8> data, bool success) { assets->onPinsRead(*this, data, success); }
+	};
+
+	void loadPins(ID id) {
+		PinsRead& read = m_pins_reads[id];
+		read.pending = true;
+		const StaticString<MAX_PATH> path(MANIFEST[id].path, ".pins");
+		FileSystem::ContentCallback cb;
+		cb.bind<&PinsRead::onLoaded>(&read);
+		read.handle = m_file_system.getContent(Path(path), cb);
+	}
+
+	void onPinsRead(PinsRead& read, Span<const u8> data, bool success) {
+		const ID id = read.id;
+		read.pending = false;
+		read.handle = FileSystem::AsyncHandle::invalid();
+		m_ready[id] = os::Timer::getRawTimestamp();
+
+		const StaticString<MAX_PATH> path(MANIFEST[id].path, ".pins");
+		if (!success) {
+			logWarning(path, " not found, pins of ", MANIFEST[id].path, " are scanned at runtime");
+			return;
+		}
+		InputMemoryStream blob(data);
+		if (!m_pins[id].deserialize(blob)) {
+			logError(path, " is invalid or outdated, save ", MANIFEST[id].path, " in the editor to bake it again");
+			return;
+		}
+		m_has_pins[id] = true;
+	}
+
+	void reportCriticalPath(u64 now) const {
+		const double to_ms = 1000.0 / os::Timer::getFrequency();
+		logInfo("Critical assets ready ", (now - m_created) * to_ms, " ms after start");
+		for (u32 i = 0; i < COUNT; ++i) {
+			if (MANIFEST[i].priority != Priority::CRITICAL) continue;
+			logInfo("  ", MANIFEST[i].path, ": requested at ", (m_requested[i] - m_created) * to_ms
+				, " ms, ready at ", (m_ready[i] - m_created) * to_ms, " ms");
+		}
+	}
+
+	ResourceManagerHub& m_resource_manager;
+	FileSystem& m_file_system;
+	Priority m_priority[COUNT];
+	PrefabPins m_pins[COUNT];
+	bool m_has_pins[COUNT] = {};
+	PinsRead m_pins_reads[COUNT];
+	bool m_failed[COUNT] = {};
+	u64 m_requested[COUNT] = {};
+	u64 m_ready[COUNT] = {};
+	const u64 m_created = os::Timer::getRawTimestamp();
+	bool m_critical_path_reported = false;
+	Array<ReadyCallback> m_callbacks;
+};
+
+// Everything the station produces, consumes or stores. Blueprints, stats, history, replication,
+// the Lua API and the HUD iterate over this, a new resource only needs a line here and in RESOURCES.
+enum class StationResource : u8 {
+	POWER,
+	HEAT,
+	WATER,
+	FOOD,
+	AIR,
+	FUEL,
+	MATERIALS,
+
+	COUNT
+};
+static constexpr u32 RESOURCE_COUNT = (u32)StationResource::COUNT;
+
+struct ResourceInfo {
+	const char* name; // prefix of Lua fields and stats series, e.g. "power_cons" or "water_stored"
+	const char* hud_format; // nullptr if not in the HUD
+	bool storable;
+};
+
+static constexpr ResourceInfo RESOURCES[] = {
+	{ "power", "%d kW", false },
+	{ "heat", "%d kJ/s", false },
+	{ "water", "%d l/day", true },
+	{ "food", "%d kcal/day", true },
+	{ "air", "%d l/h", false },
+	{ "fuel", nullptr, true },
+	{ "materials", nullptr, true },
+};
+static_assert(lengthOf(RESOURCES) == RESOURCE_COUNT);
+
+constexpr u32 getStorableCount() {
+	u32 count = 0;
+	for (const ResourceInfo& info : RESOURCES) count += info.storable ? 1 : 0;
+	return count;
+}
+
+// "<resource>_cons", "_prod", "_stored" and "_space"
+struct ResourceNames {
+	ResourceNames() {
+		for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+			cons[r] = StaticString<32>(RESOURCES[r].name, "_cons");
+			prod[r] = StaticString<32>(RESOURCES[r].name, "_prod");
+			stored[r] = StaticString<32>(RESOURCES[r].name, "_stored");
+			space[r] = StaticString<32>(RESOURCES[r].name, "_space");
+		}
+	}
+
+	StaticString<32> cons[RESOURCE_COUNT];
+	StaticString<32> prod[RESOURCE_COUNT];
+	StaticString<32> stored[RESOURCE_COUNT];
+	StaticString<32> space[RESOURCE_COUNT];
+};
+
+inline const ResourceNames& getResourceNames() {
+	static const ResourceNames names;
+	return names;
+}
+
+// One value per resource, padded to whole float4s, so arithmetic on all resources is a couple of SIMD operations
+struct alignas(16) ResourceVector {
+	static constexpr u32 SIZE = (RESOURCE_COUNT + 3) & ~3u;
+
+	static ResourceVector make(const float (&src)[RESOURCE_COUNT]) {
+		ResourceVector res;
+		memcpy(res.values, src, sizeof(src));
+		return res;
+	}
+
+	float& operator[](StationResource r) { return values[(u32)r]; }
+	float operator[](StationResource r) const { return values[(u32)r]; }
+
+	void operator+=(const ResourceVector& rhs) {
+		for (u32 i = 0; i < SIZE; i += 4) f4Store(values + i, f4Add(f4Load(values + i), f4Load(rhs.values + i)));
+	}
+
+	void operator-=(const ResourceVector& rhs) {
+		for (u32 i = 0; i < SIZE; i += 4) f4Store(values + i, f4Sub(f4Load(values + i), f4Load(rhs.values + i)));
+	}
+
+	// this += rhs * scale
+	void addScaled(const ResourceVector& rhs, float scale) {
+		const float4 s = f4Splat(scale);
+		for (u32 i = 0; i < SIZE; i += 4) f4Store(values + i, f4Add(f4Load(values + i), f4Mul(f4Load(rhs.values + i), s)));
+	}
+
+	void clamp(const ResourceVector& min, const ResourceVector& max) {
+		for (u32 i = 0; i < SIZE; i += 4) {
+			f4Store(values + i, f4Min(f4Max(f4Load(values + i), f4Load(min.values + i)), f4Load(max.values + i)));
+		}
+	}
+
+	float values[SIZE] = {};
+};
+
 struct Blueprint {
 	char type[32] = "Not set";
 	char label[64] = "Not set";
-	PrefabResource* prefab = nullptr;
+	Assets::ID prefab = Assets::NONE;
 	char desc[2048];
-	float power_cons = 0;
-	float power_prod = 0;
-	float heat_cons = 0;
-	float heat_prod = 0;
-	float water_cons = 0;
-	float water_prod = 0;
-	float food_cons = 0;
-	float food_prod = 0;
-	float air_cons = 0;
-	float air_prod = 0;
+	ResourceVector consumption;
+	ResourceVector production;
 	float volume = 0;
 	float material_cost = 0;
 	float build_time = 0;
+	float lifetime = 0; // average seconds of work between breakdowns, 0 never breaks
+
+	// fields research can modify, consumption and then production of every resource come first
+	enum Field : u8 {
+		VOLUME = 2 * RESOURCE_COUNT,
+		MATERIAL_COST,
+		BUILD_TIME,
+		LIFETIME,
+
+		FIELD_COUNT
+	};
+
+	static constexpr Field consumes(StationResource r) { return Field((u32)r); }
+	static constexpr Field produces(StationResource r) { return Field(RESOURCE_COUNT + (u32)r); }
+
+	float& operator[](Field field) { return const_cast<float&>(static_cast<const Blueprint&>(*this)[field]); }
+
+	const float& operator[](Field field) const {
+		if (field < RESOURCE_COUNT) return consumption.values[field];
+		if (field < 2 * RESOURCE_COUNT) return production.values[field - RESOURCE_COUNT];
+		switch (field) {
+			case VOLUME: return volume;
+			case MATERIAL_COST: return material_cost;
+			case BUILD_TIME: return build_time;
+			case LIFETIME: return lifetime;
+			default:
+				ASSERT(false);
+				return lifetime;
+		}
+	}
 } blueprint;
 using BlueprintHandle = u32;
 
+struct ResearchModifier {
+	static constexpr BlueprintHandle ALL_BLUEPRINTS = 0xffFFffFF;
+
+	enum Op : u8 {
+		ADD,
+		MUL
+	};
+
+	BlueprintHandle blueprint;
+	Blueprint::Field field;
+	Op op;
+	float value;
+};
+
+struct ResearchProject {
+	static constexpr u32 MAX_MODIFIERS = 4;
+	static constexpr u32 NONE = 0xffFFffFF;
+
+	char id[32];
+	char label[64];
+	float time; // seconds of work of one crew member
+	u32 prerequisite = NONE;
+	ResearchModifier modifiers[MAX_MODIFIERS];
+	u32 modifiers_count = 0;
+	float progress = 0;
+	bool done = false;
+};
+
+// FNV-1a, constexpr so event names known in code are hashed by the compiler
+constexpr u32 hashEvent(const char* str) {
+	u32 hash = 0x811c9dc5;
+	for (; *str; ++str) hash = (hash ^ u8(*str)) * 0x01000193;
+	return hash;
+}
+
+constexpr u32 operator""_event(const char* str, size_t) { return hashEvent(str); }
+
+// what a GUI event or a script signal does, looked up by event name hash
+struct GameCommand {
+	enum Type : u32 {
+		SET_TIME_MULTIPLIER,
+		CLOSE_MODULE_UI,
+		BUILD_MODULE,
+		BUILD_EXTENSION,
+		START_RESEARCH,
+		START_EXPEDITION,
+		UNDO,
+		REDO,
+		PLACE_MODULE,
+		PLACE_EXTENSION
+	};
+
+	Type type;
+	u32 arg = 0; // time multiplier, module type, blueprint, research project, expedition or placement request
+};
+
+// xorshift32, the same seed always produces the same sequence
+struct Rng {
+	Rng(u32 seed) : state(seed ? seed : 0x9E3779B9) {}
+
+	u32 next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	u32 next(u32 n) { return next() % n; }
+	float nextFloat() { return (next() >> 8) * (1.f / 16777216.f); }
+
+	u32 state;
+};
+
+// Timings collected by the benchmark suite, saved as one JSON object per line so results can be diffed between commits
+struct BenchmarkReport {
+	struct Entry {
+		StaticString<64> name;
+		u32 modules;
+		u32 crew;
+		u32 iterations = 0;
+		double total_us = 0;
+		double min_us = DBL_MAX;
+		double max_us = 0;
+		bool is_value = false; // not a timing, e.g. bytes per tick
+		double value = 0;
+	};
+
+	BenchmarkReport(IAllocator& allocator) : entries(allocator) {}
+
+	void value(const char* name, double value) {
+		Entry& e = entries.emplace();
+		e.name = name;
+		e.modules = modules;
+		e.crew = crew;
+		e.is_value = true;
+		e.value = value;
+	}
+
+	template <typename F>
+	void measure(const char* name, u32 iterations, F&& f) {
+		Entry& e = entries.emplace();
+		e.name = name;
+		e.modules = modules;
+		e.crew = crew;
+		e.iterations = iterations;
+		const double to_us = 1e6 / os::Timer::getFrequency();
+		for (u32 i = 0; i < iterations; ++i) {
+			const u64 start = os::Timer::getRawTimestamp();
+			f();
+			const double t = (os::Timer::getRawTimestamp() - start) * to_us;
+			e.total_us += t;
+			e.min_us = minimum(e.min_us, t);
+			e.max_us = maximum(e.max_us, t);
+		}
+	}
+
+	static void format(const Entry& e, char (&line)[256]) {
+		if (e.is_value) {
+			sprintf_s(line, "{\"name\": \"%s\", \"modules\": %u, \"crew\": %u, \"value\": %.3f}\n", e.name.data, e.modules, e.crew, e.value);
+		}
+		else sprintf_s(line, "{\"name\": \"%s\", \"modules\": %u, \"crew\": %u, \"iterations\": %u, \"avg_us\": %.3f, \"min_us\": %.3f, \"max_us\": %.3f}\n"
+			, e.name.data, e.modules, e.crew, e.iterations, e.total_us / maximum(e.iterations, 1u), e.min_us, e.max_us);
+	}
+
+	bool save(const char* path) const {
+		os::OutputFile file;
+		if (!file.open(path)) {
+			logError("Failed to create ", path);
+			return false;
+		}
+
+		bool res = true;
+		for (const Entry& e : entries) {
+			char line[256];
+			format(e, line);
+			res = file.write(line, stringLength(line)) && res;
+		}
+		file.close();
+		if (!res) logError("Failed to write ", path);
+		return res;
+	}
+
+	// reads back value entries written by `save`, timings are skipped
+	void loadValues(Span<const u8> content) {
+		const char* c = (const char*)content.begin();
+		const char* end = (const char*)content.end();
+		while (c < end) {
+			const char* line_end = c;
+			while (line_end < end && *line_end != '\n') ++line_end;
+			char line[256];
+			copyString(line, StringView(c, line_end));
+			c = line_end + 1;
+
+			Entry e;
+			if (sscanf(line, "{\"name\": \"%63[^\"]\", \"modules\": %u, \"crew\": %u, \"value\": %lf}", e.name.data, &e.modules, &e.crew, &e.value) != 4) continue;
+			e.is_value = true;
+			entries.push(e);
+		}
+	}
+
+	const Entry* findValue(const char* name, u32 modules, u32 crew) const {
+		for (const Entry& e : entries) {
+			if (e.is_value && e.modules == modules && e.crew == crew && equalStrings(e.name, name)) return &e;
+		}
+		return nullptr;
+	}
+
+	Array<Entry> entries;
+	u32 modules = 0;
+	u32 crew = 0;
+};
+
+// Counter-based generator, the value depends only on (key, counter),
+// so results are the same no matter which thread asks and in which order
+inline u64 randomAt(u64 key, u64 counter) {
+	u64 z = key + counter * 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+inline float randomFloatAt(u64 key, u64 counter) {
+	return (randomAt(key, counter) >> 40) * (1.f / 16777216.f);
+}
+
 struct PropertyCloner : reflection::IPropertyVisitor {
 	template <typename T>
 	void clone(const reflection::Property<T>& prop) { 
@@ -120,6 +669,211 @@ struct PropertyCloner : reflection::IPropertyVisitor {
 	int index = -1;
 };
 
+inline u32 lowestBitIndex(u64 value) {
+	ASSERT(value != 0);
+	#ifdef _MSC_VER
+		unsigned long idx;
+		_BitScanForward64(&idx, value);
+		return idx;
+	#else
+		return __builtin_ctzll(value);
+	#endif
+}
+
+// Hierarchical timing wheel, 4 levels of 256 slots over u32 ticks.
+// Scheduling and cancelling are O(1), an event is moved down at most once per level before it fires.
+// Advancing jumps straight to the next occupied slot using per-level occupancy bits,
+// so a large time jump costs the events it passes, not the ticks.
+struct TimingWheel {
+	static constexpr u32 LEVELS = 4;
+	static constexpr u32 SLOT_BITS = 8;
+	static constexpr u32 SLOTS = 1 << SLOT_BITS;
+	static constexpr u32 INVALID = 0xffFFffFF;
+	static constexpr u8 DUE = LEVELS; // level of events waiting to fire in the current tick
+
+	struct Handle {
+		u32 index = INVALID;
+		u32 generation = 0;
+	};
+
+	TimingWheel(IAllocator& allocator) : m_nodes(allocator) { clear(); }
+
+	void clear() {
+		m_nodes.clear();
+		m_free = INVALID;
+		m_now = 0;
+		m_count = 0;
+		for (List& l : m_lists) l = {};
+		memset(m_bits, 0, sizeof(m_bits));
+	}
+
+	// events due at or before `now()` fire in the next `advance`
+	Handle schedule(u32 due, u64 payload) {
+		u32 idx = m_free;
+		if (idx != INVALID) m_free = m_nodes[idx].next;
+		else {
+			idx = m_nodes.size();
+			m_nodes.emplace();
+		}
+		Node& n = m_nodes[idx];
+		n.due = due;
+		n.payload = payload;
+		n.scheduled = true;
+		link(idx);
+		++m_count;
+		return { idx, n.generation };
+	}
+
+	bool cancel(Handle handle) {
+		if (handle.index >= (u32)m_nodes.size()) return false;
+		const Node& n = m_nodes[handle.index];
+		if (!n.scheduled || n.generation != handle.generation) return false;
+		unlink(handle.index);
+		release(handle.index);
+		return true;
+	}
+
+	// fires, in due order, every event due up to `target`; `fire(payload)` can schedule and cancel events
+	template <typename F>
+	void advance(u32 target, F&& fire) {
+		if (target < m_now) return;
+		for (;;) {
+			while (m_lists[DUE * SLOTS].head != INVALID) {
+				const u32 idx = m_lists[DUE * SLOTS].head;
+				const u64 payload = m_nodes[idx].payload;
+				unlink(idx);
+				release(idx);
+				fire(payload);
+			}
+
+			u32 level, slot;
+			const u64 next = findNext(level, slot);
+			if (next > target) break;
+
+			// everything in the slot is due within it, it's moved down a level or to the due list
+			m_now = u32(next);
+			List& list = getList(level, slot);
+			u32 idx = list.head;
+			list = {};
+			m_bits[level][slot / 64] &= ~(u64(1) << (slot % 64));
+			while (idx != INVALID) {
+				const u32 next_idx = m_nodes[idx].next;
+				link(idx);
+				idx = next_idx;
+			}
+		}
+		m_now = target;
+	}
+
+	u32 now() const { return m_now; }
+	u32 size() const { return m_count; }
+
+	void serialize(OutputMemoryStream& blob) const {
+		blob.writeArray(m_nodes);
+		blob.write(m_lists);
+		blob.write(m_bits);
+		blob.write(m_free);
+		blob.write(m_now);
+		blob.write(m_count);
+	}
+
+	void deserialize(InputMemoryStream& blob) {
+		blob.readArray(&m_nodes);
+		blob.read(m_lists);
+		blob.read(m_bits);
+		blob.read(m_free);
+		blob.read(m_now);
+		blob.read(m_count);
+	}
+
+private:
+	struct Node {
+		u64 payload;
+		u32 due;
+		u32 prev;
+		u32 next; // next free node when not scheduled
+		u32 generation = 0;
+		u8 level;
+		u8 slot;
+		bool scheduled = false;
+	};
+
+	struct List {
+		u32 head = INVALID;
+		u32 tail = INVALID;
+	};
+
+	List& getList(u32 level, u32 slot) { return m_lists[level * SLOTS + slot]; }
+
+	// the level is the highest digit in which `due` differs from now, so the slot is reached
+	// exactly when all higher digits of now match
+	void link(u32 idx) {
+		Node& n = m_nodes[idx];
+		u32 level = DUE;
+		u32 slot = 0;
+		if (n.due > m_now) {
+			level = LEVELS - 1;
+			while (level > 0 && ((n.due ^ m_now) >> (level * SLOT_BITS)) == 0) --level;
+			slot = (n.due >> (level * SLOT_BITS)) & (SLOTS - 1);
+			m_bits[level][slot / 64] |= u64(1) << (slot % 64);
+		}
+		n.level = u8(level);
+		n.slot = u8(slot);
+
+		// appended, events due in the same tick fire in the order they were scheduled
+		List& list = getList(level, slot);
+		n.prev = list.tail;
+		n.next = INVALID;
+		if (list.tail != INVALID) m_nodes[list.tail].next = idx;
+		else list.head = idx;
+		list.tail = idx;
+	}
+
+	void unlink(u32 idx) {
+		Node& n = m_nodes[idx];
+		List& list = getList(n.level, n.slot);
+		if (n.prev != INVALID) m_nodes[n.prev].next = n.next;
+		else list.head = n.next;
+		if (n.next != INVALID) m_nodes[n.next].prev = n.prev;
+		else list.tail = n.prev;
+		if (list.head == INVALID && n.level != DUE) m_bits[n.level][n.slot / 64] &= ~(u64(1) << (n.slot % 64));
+	}
+
+	void release(u32 idx) {
+		Node& n = m_nodes[idx];
+		n.scheduled = false;
+		++n.generation;
+		n.next = m_free;
+		m_free = idx;
+		--m_count;
+	}
+
+	// Start of the first occupied slot after now. Events of a lower level are always due before
+	// the next slot of a higher level, so the lowest level with an occupied slot wins.
+	u64 findNext(u32& level, u32& slot) const {
+		for (level = 0; level < LEVELS; ++level) {
+			const u32 from = ((m_now >> (level * SLOT_BITS)) & (SLOTS - 1)) + 1;
+			for (u32 word = from / 64; word < SLOTS / 64; ++word) {
+				u64 bits = m_bits[level][word];
+				if (word == from / 64) bits &= ~u64(0) << (from % 64);
+				if (bits == 0) continue;
+
+				slot = word * 64 + lowestBitIndex(bits);
+				const u32 shift = (level + 1) * SLOT_BITS;
+				return ((u64(m_now) >> shift) << shift) + (u64(slot) << (level * SLOT_BITS));
+			}
+		}
+		return ~u64(0);
+	}
+
+	Array<Node> m_nodes;
+	List m_lists[(LEVELS + 1) * SLOTS]; // level DUE uses only its first list
+	u64 m_bits[LEVELS][SLOTS / 64];
+	u32 m_free;
+	u32 m_now;
+	u32 m_count;
+};
+
 struct Extension {
 	enum class Type {
 		NONE,
@@ -128,8 +882,31 @@ struct Extension {
 	};
 	u32 id;
 	EntityPtr entity;
+	StaticString<16> pin; // name of the module's pin the extension's prefab is attached to
 	float build_progress = 0.f;
 	BlueprintHandle blueprint = 0xffFFffFF;
+
+	// wear is wear_base at wear_since and grows by wear_rate per second of game time,
+	// both are re-based only when the extension starts or stops working
+	double wear_since = 0;
+	float wear_base = 0;
+	float wear_rate = 0;
+	bool broken = false;
+	float repair_progress = 0;
+	u32 repairs = 0;
+	TimingWheel::Handle failure; // predicted breakdown in GameModule::m_failures
+
+	bool isWorking() const { return build_progress >= 1 && !broken; }
+	float getWear(double time) const { return minimum(1.f, wear_base + float(time - wear_since) * wear_rate); }
+};
+
+// breakdown predicted by GameModule::m_failures, packed in the timing wheel's payload
+struct ExtensionFailure {
+	u32 module_idx;
+	u32 ext_idx;
+
+	u64 toPayload() const { return (u64(module_idx) << 32) | ext_idx; }
+	static ExtensionFailure fromPayload(u64 payload) { return { u32(payload >> 32), u32(payload) }; }
 };
 
 struct CrewMember {
@@ -137,18 +914,29 @@ struct CrewMember {
 	StaticString<128> name;
 	enum State {
 		IDLE,
-		BUILDING
+		BUILDING,
+		EXPEDITION
 	} state = IDLE;
 	u32 subject = 0xffFFffFF;
+	u32 subject_module = 0xffFFffFF; // cached graph node of `subject`, resolved lazily
+	u32 module = 0; // graph node the crew member is currently in
+	u32 next_module = 0xffFFffFF; // graph node the crew member is walking to
+	float travel_progress = 0;
 };
 
 struct Module {
 	Module(IAllocator& allocator) : extensions(allocator) {}
 
-	void serialize(OutputMemoryStream& blob) {
+	void serialize(OutputMemoryStream& blob) const {
 		blob.write(id);
+		blob.write(type);
 		blob.write(entity);
+		blob.write(detail);
+		blob.write(entities_count);
 		blob.write(build_progress);
+		blob.write(parent_id);
+		blob.write(parent_hatch);
+		blob.write(hatch);
 		blob.write(extensions.size());
 		for (const Extension* e : extensions) {
 			blob.write(*e);
@@ -157,8 +945,14 @@ struct Module {
 
 	void deserialize(InputMemoryStream& blob, IAllocator& allocator) {
 		blob.read(id);
+		blob.read(type);
 		blob.read(entity);
+		blob.read(detail);
+		blob.read(entities_count);
 		blob.read(build_progress);
+		blob.read(parent_id);
+		blob.read(parent_hatch);
+		blob.read(hatch);
 		const i32 size = blob.read<i32>();
 		extensions.resize(size);
 		for (Extension*& e : extensions) {
@@ -167,853 +961,4831 @@ struct Module {
 		}
 	}
 
+	// far from the camera only the module's root entity is kept, pins and extension prefabs are streamed in when it gets close
+	enum class Detail : u8 {
+		PROXY,
+		QUEUED,
+		FULL
+	};
+
 	u32 id;
+	u32 type; // module_N prefab
 	EntityRef entity;
+	Detail detail = Detail::FULL;
+	u32 entities_count = 0; // entities instantiated under `entity` at full detail
 	Array<Extension*> extensions;
 	float build_progress = 0.f;
+	// attachment to the station, the root module has no parent
+	u32 parent_id = 0xffFFffFF;
+	StaticString<16> parent_hatch;
+	StaticString<16> hatch;
 };
 
+// Q47.16 fixed point, used by the deterministic simulation.
+// Integer math gives the same bits on every compiler and platform, sums do not depend on their order.
+using Fixed = i64;
+static constexpr u32 FIXED_SHIFT = 16;
+static constexpr Fixed FIXED_ONE = Fixed(1) << FIXED_SHIFT;
+
+inline Fixed toFixed(float value) { return Fixed(double(value) * FIXED_ONE); }
+inline float fromFixed(Fixed value) { return float(double(value) / FIXED_ONE); }
+inline Fixed mulFixed(Fixed a, Fixed b) { return (a * b) >> FIXED_SHIFT; }
+inline Fixed divFixed(Fixed a, Fixed b) { return (a << FIXED_SHIFT) / b; }
+
 struct Stats {
-	struct {
-		float air = 0;
-		float power = 0;
-		float heat = 0;
-		float water = 0;
-		float food = 0;
-	} production;
-	struct {
-		float air = 0;
-		float power = 0;
-		float heat = 0;
-		float water = 0;
-		float food = 0;
-		float fuel = 0;
-	} consumption;
-	
-	struct {
-		float food = 0;
-		float water = 0;
-		float fuel = 0;
-		float materials = 0;
-	} stored;
-	struct {
-		float food = 0;
-		float water = 0;
-		float fuel = 0;
-		float materials = 0;
-	} storage_space;
+	ResourceVector production;
+	ResourceVector consumption;
+	ResourceVector stored;
+	ResourceVector storage_space;
 	float volume = 0;
 	float efficiency = 1.f;
 };
 
-struct SpaceStation {
-	SpaceStation(IAllocator& allocator) 
-		: modules(allocator) 
-		, crew(allocator) 
-	{}
-	Array<Module*> modules;
-	Array<CrewMember> crew;
-	Stats stats;
-};
+struct StatsSample {
+	void add(float value) {
+		min = minimum(min, value);
+		max = maximum(max, value);
+		sum += value;
+		++count;
+	}
 
-struct Assets {
-	PrefabResource* module_2 = nullptr;
-	PrefabResource* module_3 = nullptr;
-	PrefabResource* module_4 = nullptr;
-	PrefabResource* solar_panel = nullptr;
+	void add(const StatsSample& rhs) {
+		min = minimum(min, rhs.min);
+		max = maximum(max, rhs.max);
+		sum += rhs.sum;
+		count += rhs.count;
+	}
+
+	float min = FLT_MAX;
+	float max = -FLT_MAX;
+	float sum = 0;
+	u32 count = 0;
 };
 
-struct Game : ISystem {
-	Game(Engine& engine)
-		: m_engine(engine)
-	{
-		ResourceManagerHub& rm = m_engine.getResourceManager();
-		m_assets.module_2 = rm.load<PrefabResource>(Path("prefabs/module_2.fab"));
-		m_assets.module_3 = rm.load<PrefabResource>(Path("prefabs/module_3.fab"));
-		//m_assets.module_4 = rm.load<PrefabResource>(Path("prefabs/module_4.fab"));
-		m_assets.solar_panel = rm.load<PrefabResource>(Path("prefabs/solar_panel.fab"));
-	}
+// Ring of fixed-duration buckets with a segment tree over it, so any range aggregates in O(log n)
+struct StatsLevel {
+	static constexpr u32 CAPACITY = 1024; // must be power of 2
 
-	~Game() {
-		if (m_assets.module_2) m_assets.module_2->decRefCount();
-		if (m_assets.module_3) m_assets.module_3->decRefCount();
-		if (m_assets.module_4) m_assets.module_4->decRefCount();
-		m_assets.solar_panel->decRefCount();
+	StatsLevel(IAllocator& allocator) : tree(allocator) { tree.resize(CAPACITY * 2); }
+
+	void push(const StatsSample& sample) {
+		u32 i = CAPACITY + u32(pushed % CAPACITY);
+		tree[i] = sample;
+		for (i >>= 1; i > 0; i >>= 1) {
+			tree[i] = tree[i * 2];
+			tree[i].add(tree[i * 2 + 1]);
+		}
+		++pushed;
 	}
 
-	void serialize(OutputMemoryStream& stream) const override {}
-	bool deserialize(i32 version, InputMemoryStream& stream) override { return version == 0; }
+	// buckets [from, to), indexed from the first bucket ever pushed
+	StatsSample query(u64 from, u64 to) const {
+		if (pushed > CAPACITY) from = maximum(from, pushed - CAPACITY);
+		to = minimum(to, pushed);
+		if (from >= to) return {};
 
-	void createModules(World& world) override;
+		const u32 a = u32(from % CAPACITY);
+		const u32 b = u32((to - 1) % CAPACITY) + 1;
+		if (a < b) return queryRing(a, b);
 
-	const char* getName() const override { return "game"; }
+		StatsSample res = queryRing(a, CAPACITY);
+		res.add(queryRing(0, b));
+		return res;
+	}
 
-	Assets m_assets;
-	Engine& m_engine;
+	StatsSample queryRing(u32 l, u32 r) const {
+		StatsSample res;
+		for (l += CAPACITY, r += CAPACITY; l < r; l >>= 1, r >>= 1) {
+			if (l & 1) res.add(tree[l++]);
+			if (r & 1) res.add(tree[--r]);
+		}
+		return res;
+	}
+
+	Array<StatsSample> tree;
+	u64 pushed = 0;
 };
 
+// Every tracked value of `Stats` sampled each tick into per-second, per-minute and per-hour levels.
+// Memory is allocated once, old buckets are overwritten.
+struct StatsHistory {
+	// consumption and production of every resource, stored amount of storable resources, efficiency
+	static constexpr u32 EFFICIENCY = 2 * RESOURCE_COUNT + getStorableCount();
+	static constexpr u32 COUNT = EFFICIENCY + 1;
+
+	static const char* getSeriesName(u32 series) {
+		struct Names {
+			Names() {
+				const ResourceNames& names = getResourceNames();
+				u32 i = 0;
+				for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+					values[i++] = names.cons[r];
+					values[i++] = names.prod[r];
+				}
+				for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+					if (RESOURCES[r].storable) values[i++] = names.stored[r];
+				}
+				values[EFFICIENCY] = "efficiency";
+			}
+			const char* values[COUNT];
+		};
+		static const Names names;
+		ASSERT(series < COUNT);
+		return names.values[series];
+	}
 
-struct GameModule : IModule {
-	GameModule(Game& game, World& world) 
-		: m_game(game)
-		, m_world(world)
-		, m_station(game.m_engine.getAllocator())
-		, m_allocator(game.m_engine.getAllocator())
-		, m_blueprints(game.m_engine.getAllocator())
-		, m_button_callbacks(game.m_engine.getAllocator())
-	{
-		lua_State* L = m_game.m_engine.getState();
-		#define REGISTER_FUNCTION(F)                                                                                    \
-			do                                                                                                          \
+	static constexpr u32 LEVELS = 3;
+	static constexpr float LEVEL_DURATION[LEVELS] = { 1, 60, 3600 }; // seconds per bucket
+	static constexpr u32 LEVEL_RATIO = 60; // buckets merged into one bucket of the next level
+
+	StatsHistory(IAllocator& allocator) : m_levels(allocator) {
+		m_levels.reserve(COUNT * LEVELS);
+		for (u32 i = 0; i < COUNT * LEVELS; ++i) m_levels.emplace(allocator);
+	}
+
+	static u32 getSeries(const char* name) {
+		for (u32 i = 0; i < COUNT; ++i) {
+			if (equalStrings(getSeriesName(i), name)) return i;
+		}
+		return COUNT;
+	}
+
+	static void gather(const Stats& stats, float (&out)[COUNT]) {
+		u32 i = 0;
+		for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+			out[i++] = stats.consumption.values[r];
+			out[i++] = stats.production.values[r];
+		}
+		for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+			if (RESOURCES[r].storable) out[i++] = stats.stored.values[r];
+		}
+		out[EFFICIENCY] = stats.efficiency;
+	}
+
+	void sample(const Stats& stats, float time_delta) {
+		float values[COUNT];
+		gather(stats, values);
+		for (u32 i = 0; i < COUNT; ++i) m_pending[i][0].add(values[i]);
+
+		// a big time jump would only push empty buckets, skip them
+		m_bucket_time = minimum(m_bucket_time + time_delta, float(StatsLevel::CAPACITY));
+		while (m_bucket_time >= LEVEL_DURATION[0]) {
+			m_bucket_time -= LEVEL_DURATION[0];
+			closeBucket(0);
+		}
+	}
+
+	// aggregate of the last `from_ago` .. `to_ago` seconds, picks the finest level covering the range
+	StatsSample query(u32 series, float from_ago, float to_ago) const {
+		ASSERT(series < COUNT);
+		u32 level = 0;
+		while (level + 1 < LEVELS && from_ago > LEVEL_DURATION[level] * StatsLevel::CAPACITY) ++level;
+		
+		const StatsLevel& l = getLevel(series, level);
+		const u64 from_buckets = u64(ceilf(from_ago / LEVEL_DURATION[level]));
+		const u64 to_buckets = u64(to_ago / LEVEL_DURATION[level]);
+		const u64 from = l.pushed > from_buckets ? l.pushed - from_buckets : 0;
+		const u64 to = l.pushed > to_buckets ? l.pushed - to_buckets : 0;
+		return l.query(from, to);
+	}
+
+	const StatsLevel& getLevel(u32 series, u32 level) const { return m_levels[series * LEVELS + level]; }
+
+	void serialize(OutputMemoryStream& blob) const {
+		blob.write(m_bucket_time);
+		blob.write(m_pending);
+		for (const StatsLevel& l : m_levels) {
+			blob.write(l.pushed);
+			blob.write(l.tree.begin(), l.tree.size() * sizeof(l.tree[0]));
+		}
+	}
+
+	void deserialize(InputMemoryStream& blob) {
+		blob.read(m_bucket_time);
+		blob.read(m_pending);
+		for (StatsLevel& l : m_levels) {
+			blob.read(l.pushed);
+			blob.read(l.tree.begin(), l.tree.size() * sizeof(l.tree[0]));
+		}
+	}
+
+private:
+	void closeBucket(u32 level) {
+		for (u32 i = 0; i < COUNT; ++i) {
+			m_levels[i * LEVELS + level].push(m_pending[i][level]);
+			if (level + 1 < LEVELS) m_pending[i][level + 1].add(m_pending[i][level]);
+			m_pending[i][level] = {};
+		}
+		if (level + 1 < LEVELS && getLevel(0, level).pushed % LEVEL_RATIO == 0) closeBucket(level + 1);
+	}
+
+	Array<StatsLevel> m_levels;
+	StatsSample m_pending[COUNT][LEVELS];
+	float m_bucket_time = 0;
+};
+
+// Modules connected through hatches. Node index is the module's index in `SpaceStation::modules`.
+// Routes are cached as distance fields, one per destination, built on demand (limited per tick)
+// and patched incrementally when the station grows, so a crew member picks its next hatch in O(1).
+struct StationGraph {
+	static constexpr u32 INVALID_NODE = 0xffFFffFF;
+	static constexpr u16 UNREACHABLE = 0xffFF;
+	static constexpr u32 MAX_LINKS = 6;
+	static constexpr u32 MAX_CACHED_FIELDS = 64;
+
+	struct Node {
+		u32 links[MAX_LINKS];
+		u32 link_count = 0;
+	};
+
+	struct DistanceField {
+		DistanceField(IAllocator& allocator) : distances(allocator) {}
+		u32 target;
+		u32 last_used = 0;
+		Array<u16> distances;
+	};
+
+	StationGraph(IAllocator& allocator)
+		: m_allocator(allocator)
+		, m_nodes(allocator)
+		, m_fields(allocator)
+		, m_queue(allocator)
+	{}
+
+	~StationGraph() { clearCache(); }
+
+	void clear() {
+		clearCache();
+		m_nodes.clear();
+		++m_version;
+	}
+
+	void clearCache() {
+		for (DistanceField* f : m_fields) LUMIX_DELETE(m_allocator, f);
+		m_fields.clear();
+	}
+
+	u32 addNode() {
+		m_nodes.emplace();
+		++m_version;
+		for (DistanceField* f : m_fields) f->distances.push(UNREACHABLE);
+		return m_nodes.size() - 1;
+	}
+
+	// removes the last node, it must be a leaf, so no route between the remaining nodes goes through it
+	void popNode() {
+		const u32 node = m_nodes.size() - 1;
+		const Node& n = m_nodes[node];
+		ASSERT(n.link_count <= 1);
+		for (u32 i = 0; i < n.link_count; ++i) {
+			Node& other = m_nodes[n.links[i]];
+			for (u32 j = 0; j < other.link_count; ++j) {
+				if (other.links[j] == node) {
+					other.links[j] = other.links[--other.link_count];
+					break;
+				}
+			}
+		}
+		m_nodes.pop();
+		++m_version;
+
+		for (i32 i = m_fields.size() - 1; i >= 0; --i) {
+			DistanceField* f = m_fields[i];
+			if (f->target == node) {
+				LUMIX_DELETE(m_allocator, f);
+				m_fields.swapAndPop(i);
+				continue;
+			}
+			f->distances.pop();
+		}
+	}
+
+	void connect(u32 a, u32 b) {
+		Node& na = m_nodes[a];
+		Node& nb = m_nodes[b];
+		ASSERT(na.link_count < MAX_LINKS && nb.link_count < MAX_LINKS);
+		if (na.link_count == MAX_LINKS || nb.link_count == MAX_LINKS) return;
+		na.links[na.link_count++] = b;
+		nb.links[nb.link_count++] = a;
+		++m_version;
+
+		for (DistanceField* f : m_fields) {
+			relax(*f, a, b);
+			relax(*f, b, a);
+		}
+	}
+
+	void beginTick() {
+		++m_tick;
+		m_builds_this_tick = 0;
+	}
+
+	// returns the neighbour of `from` on the shortest route to `to`,
+	// INVALID_NODE if `to` is unreachable or its route is not built yet due to the per-tick budget
+	u32 getNextHop(u32 from, u32 to) {
+		++m_queries;
+		if (from == to) return to;
+		const DistanceField* field = getField(to);
+		if (!field) return INVALID_NODE;
+
+		const u16 d = field->distances[from];
+		if (d == UNREACHABLE) return INVALID_NODE;
+		const Node& n = m_nodes[from];
+		for (u32 i = 0; i < n.link_count; ++i) {
+			if (field->distances[n.links[i]] < d) return n.links[i];
+		}
+		ASSERT(false);
+		return INVALID_NODE;
+	}
+
+	DistanceField* getField(u32 target) {
+		for (DistanceField* f : m_fields) {
+			if (f->target == target) {
+				f->last_used = m_tick;
+				return f;
+			}
+		}
+
+		if (m_builds_this_tick >= m_build_budget) return nullptr;
+		++m_builds_this_tick;
+
+		DistanceField* field;
+		if ((u32)m_fields.size() < MAX_CACHED_FIELDS) {
+			field = LUMIX_NEW(m_allocator, DistanceField)(m_allocator);
+			m_fields.push(field);
+		}
+		else {
+			field = m_fields[0];
+			for (DistanceField* f : m_fields) {
+				if (f->last_used < field->last_used) field = f;
+			}
+		}
+		field->target = target;
+		field->last_used = m_tick;
+		build(*field);
+		return field;
+	}
+
+	IAllocator& m_allocator;
+	Array<Node> m_nodes;
+	Array<DistanceField*> m_fields;
+	u32 m_build_budget = 4; // distance fields built per tick
+	u32 m_builds_this_tick = 0;
+	u32 m_tick = 0;
+	u64 m_queries = 0;
+	u32 m_version = 0; // changes with every added node or link
+
+private:
+	void build(DistanceField& field) {
+		field.distances.resize(m_nodes.size());
+		for (u16& d : field.distances) d = UNREACHABLE;
+		field.distances[field.target] = 0;
+		m_queue.clear();
+		m_queue.push(field.target);
+		propagate(field);
+	}
+
+	// `a` got a new link to `b`, lower distances reachable through it
+	void relax(DistanceField& field, u32 a, u32 b) {
+		const u16 da = field.distances[a];
+		if (da == UNREACHABLE || da + 1 >= field.distances[b]) return;
+		field.distances[b] = da + 1;
+		m_queue.clear();
+		m_queue.push(b);
+		propagate(field);
+	}
+
+	void propagate(DistanceField& field) {
+		for (i32 head = 0; head < m_queue.size(); ++head) {
+			const u32 n = m_queue[head];
+			const u16 d = field.distances[n] + 1;
+			const Node& node = m_nodes[n];
+			for (u32 i = 0; i < node.link_count; ++i) {
+				const u32 l = node.links[i];
+				if (field.distances[l] <= d) continue;
+				field.distances[l] = d;
+				m_queue.push(l);
+			}
+		}
+	}
+
+	Array<u32> m_queue;
+};
+
+struct ExpeditionOutcome {
+	float materials = 0;
+	float fuel = 0;
+	u32 recruits = 0;
+	u32 hazards = 0;
+};
+
+// Resupply from the ground, every ship docks, unloads its cargo and leaves
+struct SupplySchedule {
+	float interval = 1800; // seconds between arrivals
+	float unload_time = 300;
+	float undock_time = 120;
+	ResourceVector cargo = ResourceVector::make({ 0, 0, 0, 0, 0, 400, 1500 });
+};
+
+struct SupplyShip {
+	enum State : u8 {
+		EN_ROUTE,
+		DOCKED,
+		UNLOADED
+	};
+
+	u32 id;
+	State state = EN_ROUTE;
+	double next_event_time; // game time of the ship's next event
+	TimingWheel::Handle next_event;
+	ResourceVector cargo;
+};
+
+// Crew away from the station. Every leg draws its events from the expedition's own random stream,
+// so the outcome depends only on the key and the number of legs, not on threads or frame timing.
+struct Expedition {
+	static constexpr u32 MAX_CREW = 4;
+	static constexpr float LEG_DURATION = 60; // seconds of game time per leg
+	static constexpr float FUEL_PER_LEG = 1; // per crew member
+
+	u32 getLegsCount() const { return u32(duration / LEG_DURATION); }
+
+	static void simulateLeg(u64 key, u32 leg, u32 crew_count, ExpeditionOutcome& outcome) {
+		const u64 c = leg * 6ull;
+		if (randomFloatAt(key, c) < 0.3f) outcome.materials += (200 + 800 * randomFloatAt(key, c + 1)) * crew_count;
+		if (randomFloatAt(key, c + 2) < 0.1f) outcome.fuel += 50 + 250 * randomFloatAt(key, c + 3);
+		if (randomFloatAt(key, c + 4) < 0.02f) ++outcome.recruits;
+		if (randomFloatAt(key, c + 5) < 0.005f) {
+			// lose half of the haul
+			outcome.materials *= 0.5f;
+			outcome.fuel *= 0.5f;
+			++outcome.hazards;
+		}
+	}
+
+	u32 id;
+	u64 key;
+	u32 crew[MAX_CREW];
+	u32 crew_count = 0;
+	float duration;
+	float elapsed = 0;
+	u32 legs_done = 0;
+	ExpeditionOutcome outcome;
+};
+
+struct ExpeditionRequest {
+	u32 crew[Expedition::MAX_CREW];
+	u32 crew_count = 0;
+	float duration;
+};
+
+// build preview dropped on a pin, the module is checked by its id when the command runs
+struct PlacementRequest {
+	u32 module;
+	u32 module_id;
+	StaticString<16> pin;
+	u32 arg; // module type or blueprint
+};
+
+struct ExpeditionForecast {
+	u32 trials = 0;
+	float materials_mean = 0;
+	float materials_p10 = 0;
+	float materials_p50 = 0;
+	float materials_p90 = 0;
+	float fuel_mean = 0;
+	float recruit_chance = 0;
+	float hazard_chance = 0;
+};
+
+struct ModuleStreaming {
+	ModuleStreaming(IAllocator& allocator) : queue(allocator) {}
+
+	float expand_distance = 150;
+	float collapse_distance = 200; // larger than `expand_distance` so modules on the edge don't flicker
+	u32 max_full_modules = 256;
+	u32 expands_per_frame = 4;
+	u32 checks_per_frame = 2048;
+
+	bool has_viewpoint = false; // scripted viewpoint in station space instead of the camera, for headless runs
+	DVec3 viewpoint;
+
+	Array<u32> queue; // modules waiting to be expanded
+	u32 next_check = 0;
+	u32 full_modules = 0;
+	u32 entities = 0; // entities of the station hierarchy, including roots
+	u32 expanded_total = 0;
+	u32 collapsed_total = 0;
+};
+
+// Per crew member needs, all in 0..1; hunger, thirst and fatigue are bad when high, health and morale when low.
+// Stored as structure of arrays parallel to SpaceStation::crew and updated four crew members at a time,
+// cold data such as names stay in CrewMember.
+struct CrewNeeds {
+	enum Stream : u32 {
+		HUNGER,
+		THIRST,
+		FATIGUE,
+		HEALTH,
+		MORALE,
+		ACTIVE, // 1 while building or on expedition, 0 while resting
+
+		STREAM_COUNT
+	};
+
+	// per tick deltas, the same for the whole station
+	struct Rates {
+		float hunger;
+		float thirst;
+		float fatigue_active;
+		float fatigue_rest;
+		float heal;
+		float damage;
+		float morale;
+		float morale_penalty;
+	};
+
+	explicit CrewNeeds(IAllocator& allocator) : m_allocator(allocator) {}
+	~CrewNeeds() { m_allocator.deallocate(m_data); }
+
+	float* get(Stream stream) const { return m_data + stream * m_capacity; }
+	u32 size() const { return m_size; }
+	void clear() { m_size = 0; }
+
+	// crew is only ever appended or cleared, so new members are at the end; they start fed, rested and healthy
+	void resize(u32 size) {
+		if (size > m_capacity) reserve(maximum(size, m_capacity * 2));
+		for (u32 i = m_size; i < size; ++i) {
+			get(HUNGER)[i] = 0;
+			get(THIRST)[i] = 0;
+			get(FATIGUE)[i] = 0;
+			get(HEALTH)[i] = 1;
+			get(MORALE)[i] = 1;
+			get(ACTIVE)[i] = 0;
+		}
+		m_size = size;
+	}
+
+	void update(const Rates& rates) {
+		PROFILE_FUNCTION();
+		const float4 zero = f4Splat(0);
+		const float4 one = f4Splat(1);
+		const float4 threshold = f4Splat(0.8f);
+		const float4 hunger_delta = f4Splat(rates.hunger);
+		const float4 thirst_delta = f4Splat(rates.thirst);
+		// active * (up + rest) - rest is `up` for active crew and `-rest` for resting crew
+		const float4 fatigue_active = f4Splat(rates.fatigue_active + rates.fatigue_rest);
+		const float4 fatigue_rest = f4Splat(rates.fatigue_rest);
+		const float4 heal = f4Splat(rates.heal);
+		const float4 damage = f4Splat(rates.damage);
+		const float4 morale_rate = f4Splat(rates.morale);
+		const float4 morale_base = f4Splat(1 - rates.morale_penalty);
+		const float4 needs_weight = f4Splat(0.2f);
+		const float4 health_weight = f4Splat(0.4f);
+		auto saturate = [&](float4 v) { return f4Min(f4Max(v, zero), one); };
+
+		float* hunger_ptr = get(HUNGER);
+		float* thirst_ptr = get(THIRST);
+		float* fatigue_ptr = get(FATIGUE);
+		float* health_ptr = get(HEALTH);
+		float* morale_ptr = get(MORALE);
+		const float* active_ptr = get(ACTIVE);
+		// capacity is a multiple of 4, lanes past m_size are updated too and ignored
+		for (u32 i = 0; i < m_size; i += 4) {
+			const float4 hunger = saturate(f4Add(f4Load(hunger_ptr + i), hunger_delta));
+			const float4 thirst = saturate(f4Add(f4Load(thirst_ptr + i), thirst_delta));
+			const float4 active = f4Load(active_ptr + i);
+			const float4 fatigue = saturate(f4Add(f4Load(fatigue_ptr + i), f4Sub(f4Mul(active, fatigue_active), fatigue_rest)));
+
+			const float4 distress = f4Add(f4Add(f4Max(f4Sub(hunger, threshold), zero), f4Max(f4Sub(thirst, threshold), zero)), f4Max(f4Sub(fatigue, threshold), zero));
+			const float4 health = saturate(f4Sub(f4Add(f4Load(health_ptr + i), heal), f4Mul(distress, damage)));
+
+			const float4 needs = f4Add(f4Add(hunger, thirst), fatigue);
+			const float4 target = saturate(f4Sub(f4Sub(morale_base, f4Mul(needs, needs_weight)), f4Mul(f4Sub(one, health), health_weight)));
+			const float4 morale = f4Load(morale_ptr + i);
+
+			f4Store(hunger_ptr + i, hunger);
+			f4Store(thirst_ptr + i, thirst);
+			f4Store(fatigue_ptr + i, fatigue);
+			f4Store(health_ptr + i, health);
+			f4Store(morale_ptr + i, f4Add(morale, f4Mul(f4Sub(target, morale), morale_rate)));
+		}
+	}
+
+	void serialize(OutputMemoryStream& blob) const {
+		blob.write(m_size);
+		for (u32 s = 0; s < STREAM_COUNT; ++s) blob.write(get((Stream)s), m_size * sizeof(float));
+	}
+
+	void deserialize(InputMemoryStream& blob) {
+		const u32 size = blob.read<u32>();
+		clear();
+		resize(size);
+		for (u32 s = 0; s < STREAM_COUNT; ++s) blob.read(get((Stream)s), size * sizeof(float));
+	}
+
+private:
+	void reserve(u32 capacity) {
+		capacity = maximum((capacity + 3) & ~3u, 64u);
+		float* data = (float*)m_allocator.allocate(STREAM_COUNT * capacity * sizeof(float), 16);
+		memset(data, 0, STREAM_COUNT * capacity * sizeof(float));
+		for (u32 s = 0; s < STREAM_COUNT && m_data; ++s) {
+			memcpy(data + s * capacity, get((Stream)s), m_size * sizeof(float));
+		}
+		m_allocator.deallocate(m_data);
+		m_data = data;
+		m_capacity = capacity;
+	}
+
+	IAllocator& m_allocator;
+	float* m_data = nullptr; // STREAM_COUNT streams of m_capacity floats, 16B aligned
+	u32 m_size = 0;
+	u32 m_capacity = 0;
+};
+
+// Per module temperature in kelvins. Heat flows through hatches (links of StationGraph) and radiates to space.
+// Links are stored in ELL layout, MAX_LINKS neighbour slots per module, unused slots point back to the module
+// itself so they add nothing, and the stencil then runs on four modules at a time.
+struct ThermalField {
+	static constexpr u32 MAX_LINKS = StationGraph::MAX_LINKS;
+	static constexpr float SPACE_TEMPERATURE = 3;
+	static constexpr float MAX_TEMPERATURE = 1000;
+	static constexpr float NOMINAL_TEMPERATURE = 293;
+	static constexpr float HOT_TEMPERATURE = 313; // extensions start losing efficiency
+	static constexpr float HEAT_CAPACITY = 2000; // kJ/K, module structure and air
+	static constexpr float CONDUCTANCE = 2; // kJ/(s*K) through one hatch
+	static constexpr float EMISSION = 10; // kJ/s radiated by a module at nominal temperature
+	// explicit Euler is stable below C / (links * G + radiation derivative at MAX_TEMPERATURE), we keep half of that
+	static constexpr float MAX_SUBSTEP = 0.5f * HEAT_CAPACITY / (MAX_LINKS * CONDUCTANCE + 4 * EMISSION * (MAX_TEMPERATURE / NOMINAL_TEMPERATURE) * (MAX_TEMPERATURE / NOMINAL_TEMPERATURE) * (MAX_TEMPERATURE / NOMINAL_TEMPERATURE) / NOMINAL_TEMPERATURE);
+	static constexpr u32 MAX_SUBSTEPS = 64;
+
+	explicit ThermalField(IAllocator& allocator) : m_allocator(allocator) {}
+	~ThermalField() {
+		m_allocator.deallocate(m_data);
+		m_allocator.deallocate(m_links);
+	}
+
+	u32 size() const { return m_size; }
+	float* getTemperatures() const { return m_data + m_current * m_capacity; }
+	float* getHeat() const { return m_data + 2 * m_capacity; } // net heat input in kJ/s, set before each step
+
+	void clear() {
+		m_size = 0;
+		m_graph_version = 0xffFFffFF;
+	}
+
+	// modules are only ever appended or cleared, new ones start at nominal temperature
+	void resize(u32 size) {
+		if (size > m_capacity) reserve(maximum(size, m_capacity * 2));
+		float* temperatures = getTemperatures();
+		for (u32 i = m_size; i < size; ++i) temperatures[i] = NOMINAL_TEMPERATURE;
+		m_size = size;
+	}
+
+	void syncLinks(const StationGraph& graph) {
+		if (graph.m_version == m_graph_version) return;
+		m_graph_version = graph.m_version;
+		resize(graph.m_nodes.size());
+		for (u32 i = 0; i < m_size; ++i) {
+			const StationGraph::Node& n = graph.m_nodes[i];
+			for (u32 slot = 0; slot < MAX_LINKS; ++slot) {
+				m_links[slot * m_capacity + i] = slot < n.link_count ? n.links[slot] : i;
+			}
+		}
+	}
+
+	void setLink(u32 node, u32 slot, u32 other) { m_links[slot * m_capacity + node] = other; }
+
+	static float getTemperatureEfficiency(float temperature) {
+		if (temperature <= HOT_TEMPERATURE) return 1;
+		return maximum(0.25f, 1 - (temperature - HOT_TEMPERATURE) / 50);
+	}
+
+	float getEfficiency(u32 module) const { return module < m_size ? getTemperatureEfficiency(getTemperatures()[module]) : 1; }
+
+	// big time steps are split into stable substeps, beyond MAX_SUBSTEPS the remaining time is dropped,
+	// temperatures then lag behind but never blow up
+	void step(float time_delta) {
+		PROFILE_FUNCTION();
+		if (m_size == 0 || time_delta <= 0) return;
+		const u32 substeps = clamp(u32(time_delta / MAX_SUBSTEP) + 1, 1u, MAX_SUBSTEPS);
+		const float dt = minimum(time_delta / substeps, MAX_SUBSTEP);
+
+		const float4 conductance = f4Splat(CONDUCTANCE);
+		const float4 emission = f4Splat(EMISSION / (NOMINAL_TEMPERATURE * NOMINAL_TEMPERATURE * NOMINAL_TEMPERATURE * NOMINAL_TEMPERATURE));
+		const float4 to_temperature = f4Splat(dt / HEAT_CAPACITY);
+		const float4 min_temperature = f4Splat(SPACE_TEMPERATURE);
+		const float4 max_temperature = f4Splat(MAX_TEMPERATURE);
+		const float* heat_ptr = getHeat();
+		for (u32 s = 0; s < substeps; ++s) {
+			const float* src = getTemperatures();
+			float* dst = m_data + (1 - m_current) * m_capacity;
+			// capacity is a multiple of 4, lanes past m_size only read themselves
+			for (u32 i = 0; i < m_size; i += 4) {
+				const float4 t = f4Load(src + i);
+				float4 flux = f4Splat(0);
+				for (u32 slot = 0; slot < MAX_LINKS; ++slot) {
+					const u32* links = m_links + slot * m_capacity + i;
+					alignas(16) const float neighbours[] = { src[links[0]], src[links[1]], src[links[2]], src[links[3]] };
+					flux = f4Add(flux, f4Load(neighbours));
+				}
+				flux = f4Sub(flux, f4Mul(t, f4Splat(MAX_LINKS)));
+				const float4 t2 = f4Mul(t, t);
+				const float4 radiated = f4Mul(f4Mul(t2, t2), emission);
+				const float4 heat = f4Sub(f4Add(f4Load(heat_ptr + i), f4Mul(flux, conductance)), radiated);
+				f4Store(dst + i, f4Min(f4Max(f4Add(t, f4Mul(heat, to_temperature)), min_temperature), max_temperature));
+			}
+			m_current = 1 - m_current;
+		}
+	}
+
+	void serialize(OutputMemoryStream& blob) const {
+		blob.write(m_size);
+		blob.write(getTemperatures(), m_size * sizeof(float));
+	}
+
+	void deserialize(InputMemoryStream& blob) {
+		const u32 size = blob.read<u32>();
+		clear();
+		resize(size);
+		blob.read(getTemperatures(), size * sizeof(float));
+	}
+
+private:
+	void reserve(u32 capacity) {
+		capacity = maximum((capacity + 3) & ~3u, 64u);
+		float* data = (float*)m_allocator.allocate(3 * capacity * sizeof(float), 16);
+		u32* links = (u32*)m_allocator.allocate(MAX_LINKS * capacity * sizeof(u32), 16);
+		memset(data, 0, 3 * capacity * sizeof(float));
+		for (u32 i = 0; i < capacity; ++i) {
+			for (u32 slot = 0; slot < MAX_LINKS; ++slot) {
+				links[slot * capacity + i] = i < m_size ? m_links[slot * m_capacity + i] : i;
+			}
+		}
+		if (m_data) memcpy(data, getTemperatures(), m_size * sizeof(float));
+		m_allocator.deallocate(m_data);
+		m_allocator.deallocate(m_links);
+		m_data = data;
+		m_links = links;
+		m_capacity = capacity;
+		m_current = 0;
+	}
+
+	IAllocator& m_allocator;
+	float* m_data = nullptr; // 2 temperature buffers and heat input, m_capacity floats each
+	u32* m_links = nullptr; // MAX_LINKS slots of m_capacity module indices
+	u32 m_current = 0; // which temperature buffer is current
+	u32 m_size = 0;
+	u32 m_capacity = 0;
+	u32 m_graph_version = 0xffFFffFF;
+};
+
+// Built solar panels as structure of arrays, normals in the space of the station's orbiting root.
+// While the panels do not change, output depends only on the orbit phase, so it's cached per phase;
+// time warp then costs table lookups and the vectorized kernel runs once per newly reached phase.
+struct SolarPanels {
+	static constexpr u32 PHASES = 1024;
+	static constexpr float EARTH_RADIUS = 6378e3f;
+	static constexpr float ORBIT_RADIUS = EARTH_RADIUS + 400e3f;
+	static constexpr float PENUMBRA = 50e3f; // meters, soft edge of Earth's shadow at the orbit
+	static constexpr u32 MAX_SAMPLES = 16; // of the arc the orbit covered since the last update
+
+	explicit SolarPanels(IAllocator& allocator)
+		: m_allocator(allocator)
+		, m_known_normals(allocator)
+	{
+		// the sun is in +X, Earth at the origin and the station orbits in the XZ plane as in GameModule::update
+		for (u32 i = 0; i < PHASES; ++i) {
+			const float angle = 2 * PI * i / PHASES;
+			const Quat rot({0, 1, 0}, -angle + PI * 0.5f);
+			const Vec3 sun = rot.conjugated().rotate(Vec3(1, 0, 0));
+			m_sun[0][i] = sun.x;
+			m_sun[1][i] = sun.y;
+			m_sun[2][i] = sun.z;
+			const float along = cosf(angle) * ORBIT_RADIUS;
+			const float across = fabsf(sinf(angle)) * ORBIT_RADIUS;
+			m_light[i] = along >= 0 ? 1.f : clamp((across - EARTH_RADIUS) / PENUMBRA + 0.5f, 0.f, 1.f);
+		}
+		invalidate();
+	}
+
+	~SolarPanels() { m_allocator.deallocate(m_data); }
+
+	u32 size() const { return m_size; }
+
+	void clear() {
+		m_size = 0;
+		invalidate();
+	}
+
+	// `peak` is the output when the panel faces the sun
+	void push(const Vec3& normal, float peak) {
+		if (m_size == m_capacity) reserve(maximum(64u, m_capacity * 2));
+		m_data[m_size] = normal.x;
+		m_data[m_capacity + m_size] = normal.y;
+		m_data[2 * m_capacity + m_size] = normal.z;
+		m_data[3 * m_capacity + m_size] = peak;
+		++m_size;
+		invalidate();
+	}
+
+	// panels of collapsed modules have no entity, they keep the normal from when they had one
+	void setKnownNormal(u32 extension, const Vec3& normal) { m_known_normals.insert(extension, normal); }
+	bool getKnownNormal(u32 extension, Vec3& normal) const {
+		auto iter = m_known_normals.find(extension);
+		if (!iter.isValid()) return false;
+		normal = iter.value();
+		return true;
+	}
+	void forgetNormals() { m_known_normals.clear(); }
+
+	static u32 getPhase(float angle) {
+		float a = fmodf(angle, 2 * PI);
+		if (a < 0) a += 2 * PI;
+		return u32(a * (PHASES / (2 * PI)) + 0.5f) % PHASES;
+	}
+
+	float getLight(float angle) const { return m_light[getPhase(angle)]; }
+
+	// average output over the arc of the orbit from `from` to `to`
+	float getOutput(float from, float to) {
+		const float arc = to - from;
+		const u32 samples = clamp(u32(arc * (PHASES / (2 * PI))) + 1, 1u, MAX_SAMPLES);
+		float sum = 0;
+		for (u32 i = 0; i < samples; ++i) {
+			const u32 phase = getPhase(to - arc * i / samples);
+			if (m_output[phase] < 0) m_output[phase] = evaluate(phase);
+			sum += m_output[phase];
+		}
+		return sum / samples;
+	}
+
+	float evaluate(u32 phase) const {
+		if (m_light[phase] == 0) return 0;
+
+		const float4 zero = f4Splat(0);
+		const float4 sun_x = f4Splat(m_sun[0][phase]);
+		const float4 sun_y = f4Splat(m_sun[1][phase]);
+		const float4 sun_z = f4Splat(m_sun[2][phase]);
+		const float* nx = m_data;
+		const float* ny = m_data + m_capacity;
+		const float* nz = m_data + 2 * m_capacity;
+		const float* peak = m_data + 3 * m_capacity;
+		float4 sum = zero;
+		// lanes past m_size have zero peak
+		for (u32 i = 0; i < m_size; i += 4) {
+			const float4 cos_angle = f4Add(f4Add(f4Mul(f4Load(nx + i), sun_x), f4Mul(f4Load(ny + i), sun_y)), f4Mul(f4Load(nz + i), sun_z));
+			sum = f4Add(sum, f4Mul(f4Max(cos_angle, zero), f4Load(peak + i)));
+		}
+		alignas(16) float lanes[4];
+		f4Store(lanes, sum);
+		return (lanes[0] + lanes[1] + lanes[2] + lanes[3]) * m_light[phase];
+	}
+
+private:
+	void invalidate() {
+		for (float& o : m_output) o = -1;
+	}
+
+	void reserve(u32 capacity) {
+		float* data = (float*)m_allocator.allocate(4 * capacity * sizeof(float), 16);
+		memset(data, 0, 4 * capacity * sizeof(float));
+		for (u32 s = 0; s < 4 && m_data; ++s) memcpy(data + s * capacity, m_data + s * m_capacity, m_size * sizeof(float));
+		m_allocator.deallocate(m_data);
+		m_data = data;
+		m_capacity = capacity;
+	}
+
+	IAllocator& m_allocator;
+	float* m_data = nullptr; // normal x, y, z and peak output, m_capacity floats each
+	u32 m_size = 0;
+	u32 m_capacity = 0;
+	HashMap<u32, Vec3> m_known_normals;
+	float m_sun[3][PHASES]; // sun direction in station space
+	float m_light[PHASES]; // 0 in Earth's shadow, 1 in full sunlight
+	float m_output[PHASES]; // cached sum of all panels, negative if not computed yet
+};
+
+struct SpaceStation {
+	SpaceStation(IAllocator& allocator) 
+		: modules(allocator) 
+		, crew(allocator) 
+		, needs(allocator)
+		, graph(allocator)
+		, thermal(allocator)
+		, history(allocator)
+	{}
+	Array<Module*> modules;
+	Array<CrewMember> crew;
+	CrewNeeds needs;
+	StationGraph graph;
+	ThermalField thermal;
+	Stats stats;
+	StatsHistory history;
+};
+
+// Undoable construction actions. An action records only the object it created, so recording is O(1)
+// and undo/redo touch only that object: undo goes in reverse order, so the module of the latest action
+// is always the station's last module and its extension the last extension of its module.
+// Objects are referenced by index and verified by id; modules are removed only by undo, so indices are stable.
+// Undo refreshes the recorded object with its state at that moment, redo brings it back exactly like that.
+// The oldest actions are dropped once the history exceeds `budget` bytes.
+struct ConstructionHistory {
+	struct Action {
+		enum Kind : u8 {
+			ADD_MODULE,
+			ADD_EXTENSION
+		};
+
+		Kind kind;
+		u32 module; // index of the added module, or of the module the extension was added to
+		u32 module_id;
+		// ADD_MODULE
+		u32 type;
+		u32 parent; // index
+		StaticString<16> parent_hatch;
+		float build_progress;
+		// ADD_EXTENSION
+		Extension extension;
+	};
+
+	ConstructionHistory(IAllocator& allocator) : actions(allocator) {}
+
+	void clear() {
+		actions.clear();
+		done = 0;
+	}
+
+	// a new action drops everything that could be redone
+	void push(const Action& action) {
+		actions.resize(done);
+		actions.push(action);
+		++done;
+		trim();
+	}
+
+	void trim() {
+		const u32 max_count = maximum(1u, u32(budget / sizeof(Action)));
+		if ((u32)actions.size() <= max_count) return;
+
+		const u32 drop = actions.size() - max_count;
+		for (u32 i = drop; i < (u32)actions.size(); ++i) actions[i - drop] = actions[i];
+		actions.resize(max_count);
+		done = done > drop ? done - drop : 0;
+		dropped += drop;
+	}
+
+	bool canUndo() const { return done > 0; }
+	bool canRedo() const { return done < (u32)actions.size(); }
+	u64 getBytes() const { return actions.size() * sizeof(Action); }
+
+	Array<Action> actions; // [0, done) can be undone, [done, size) redone
+	u32 done = 0;
+	u64 budget = 64 * 1024;
+	u32 dropped = 0;
+};
+
+// Saved station design, modules attached hatch to hatch and their extensions.
+// Parents always come before their children, so the whole station is instantiated in one forward pass.
+struct StationTemplate {
+	static constexpr u32 MAGIC = 0x5354504c; // 'STPL'
+	static constexpr u32 VERSION = 0;
+	static constexpr u32 NO_PARENT = 0xffFFffFF;
+
+	struct Module {
+		u32 type; // module_N prefab
+		u32 parent = NO_PARENT; // index in `modules`
+		StaticString<16> parent_hatch; // pin of the parent this module is attached to
+		StaticString<16> hatch; // own pin attached to `parent_hatch`
+		float build_progress = 1;
+	};
+
+	struct Extension {
+		u32 module; // index in `modules`
+		StaticString<32> blueprint;
+		StaticString<16> pin; // empty for extensions without a prefab
+		float build_progress = 1;
+	};
+
+	StationTemplate(IAllocator& allocator)
+		: modules(allocator)
+		, extensions(allocator)
+	{}
+
+	u32 addModule(u32 type, u32 parent = NO_PARENT, const char* parent_hatch = "", const char* hatch = "hatch_0") {
+		ASSERT(parent == NO_PARENT || parent < (u32)modules.size());
+		Module& m = modules.emplace();
+		m.type = type;
+		m.parent = parent;
+		m.parent_hatch = parent_hatch;
+		m.hatch = parent == NO_PARENT ? "" : hatch;
+		return modules.size() - 1;
+	}
+
+	void addExtension(u32 module, const char* blueprint, const char* pin = "", float build_progress = 1) {
+		ASSERT(module < (u32)modules.size());
+		Extension& e = extensions.emplace();
+		e.module = module;
+		e.blueprint = blueprint;
+		e.pin = pin;
+		e.build_progress = build_progress;
+	}
+
+	void serialize(OutputMemoryStream& blob) const {
+		blob.write(MAGIC);
+		blob.write(VERSION);
+		blob.writeArray(modules);
+		blob.writeArray(extensions);
+	}
+
+	bool deserialize(InputMemoryStream& blob) {
+		if (blob.read<u32>() != MAGIC) return false;
+		if (blob.read<u32>() != VERSION) return false;
+		blob.readArray(&modules);
+		blob.readArray(&extensions);
+		if (blob.hasOverflow()) return false;
+
+		for (u32 i = 0; i < (u32)modules.size(); ++i) {
+			if (modules[i].parent != NO_PARENT && modules[i].parent >= i) return false;
+		}
+		for (const Extension& e : extensions) {
+			if (e.module >= (u32)modules.size()) return false;
+		}
+		return true;
+	}
+
+	Array<Module> modules;
+	Array<Extension> extensions;
+};
+
+inline void writeVarint(OutputMemoryStream& blob, u64 value) {
+	while (value >= 0x80) {
+		blob.write(u8(value | 0x80));
+		value >>= 7;
+	}
+	blob.write(u8(value));
+}
+
+inline u64 readVarint(InputMemoryStream& blob) {
+	u64 value = 0;
+	for (u32 shift = 0; shift < 64; shift += 7) {
+		const u8 b = blob.read<u8>();
+		value |= u64(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) break;
+	}
+	return value;
+}
+
+inline u32 zigzag(i32 value) { return (u32(value) << 1) ^ u32(value >> 31); }
+inline i32 unzigzag(u32 value) { return i32(value >> 1) ^ -i32(value & 1); }
+
+// [literal count, literals, zero count]... as varints. Saved station state is mostly zero padding of fixed-size
+// names and defaulted fields, this removes it at close to memcpy speed. Single zeros stay in literals,
+// so the output is never larger than `getZeroRunsBound`.
+inline u64 getZeroRunsBound(u64 size) { return size + size / 128 + 16; }
+
+inline void compressZeroRuns(Span<const u8> src, OutputMemoryStream& dst) {
+	const u8* p = src.begin();
+	const u8* end = src.end();
+	while (p != end) {
+		const u8* literals = p;
+		while (p != end && !(p[0] == 0 && (p + 1 == end || p[1] == 0))) ++p;
+		writeVarint(dst, u64(p - literals));
+		dst.write(literals, u64(p - literals));
+
+		const u8* zeros = p;
+		while (p != end && *p == 0) ++p;
+		writeVarint(dst, u64(p - zeros));
+	}
+}
+
+inline bool decompressZeroRuns(InputMemoryStream& src, u64 size, OutputMemoryStream& dst) {
+	dst.clear();
+	dst.reserve(size);
+	while (dst.size() < size) {
+		const u64 literals = readVarint(src);
+		if (src.hasOverflow() || literals > size - dst.size() || literals > src.size() - src.getPosition()) return false;
+		dst.write(src.skip(literals), literals);
+
+		const u64 zeros = readVarint(src);
+		if (src.hasOverflow() || zeros > size - dst.size()) return false;
+		const u64 offset = dst.size();
+		dst.resize(offset + zeros);
+		memset(dst.getMutableData() + offset, 0, zeros);
+	}
+	return true;
+}
+
+// Station state flattened to quantized integer fields, so changes are cheap to detect and small to send
+struct ReplicationRecord {
+	enum class Kind : u8 {
+		MODULE,
+		EXTENSION,
+		CREW,
+		STATS,
+		EFFICIENCY,
+		REMOVED,
+		END
+	};
+
+	static constexpr u32 MAX_FIELDS = 16;
+
+	static u32 quantizeProgress(float value) { return u32(clamp(value, 0.f, 1.f) * 0xffFF + 0.5f); }
+	// fixed-point steps per unit, resources are large amounts, efficiency lies in [0, 1]
+	static constexpr float RESOURCE_SCALE = 16;
+	static constexpr float EFFICIENCY_SCALE = 4096;
+	static u32 quantizeStat(float value, float scale) { return u32(i32(value * scale)); }
+	static float dequantizeStat(u32 value, float scale) { return i32(value) / scale; }
+
+	static u64 getKey(Kind kind, u32 id) { return (u64(kind) << 32) | id; }
+
+	u32 fields[MAX_FIELDS] = {};
+};
+
+// Sends only what changed since the previous tick, with a full keyframe every KEYFRAME_INTERVAL ticks.
+// Every record is encoded as a delta against the baseline, a keyframe is a delta against nothing.
+// Message: u8 version, u8 keyframe, u32 tick, records [kind, id, field mask, zigzag deltas of masked fields, name of new crew], END
+struct ReplicationEncoder {
+	static constexpr u8 VERSION = 1;
+	static constexpr u32 KEYFRAME_INTERVAL = 300;
+
+	ReplicationEncoder(IAllocator& allocator)
+		: m_baseline(allocator)
+		, m_removed(allocator)
+		, m_message(allocator)
+	{}
+
+	const OutputMemoryStream& encode(const SpaceStation& station) {
+		PROFILE_FUNCTION();
+		using Kind = ReplicationRecord::Kind;
+		const bool keyframe = m_tick % KEYFRAME_INTERVAL == 0;
+		if (keyframe) m_baseline.clear();
+		m_message.clear();
+		m_message.write(VERSION);
+		m_message.write(u8(keyframe));
+		m_message.write(m_tick);
+
+		ReplicationRecord rec;
+		for (const Module* m : station.modules) {
+			rec.fields[0] = m->type;
+			rec.fields[1] = ReplicationRecord::quantizeProgress(m->build_progress);
+			write(Kind::MODULE, m->id, rec, 2, nullptr);
+			for (const Extension* ext : m->extensions) {
+				rec.fields[0] = m->id;
+				rec.fields[1] = ext->blueprint;
+				rec.fields[2] = ReplicationRecord::quantizeProgress(ext->build_progress);
+				write(Kind::EXTENSION, ext->id, rec, 3, nullptr);
+			}
+		}
+
+		for (const CrewMember& c : station.crew) {
+			rec.fields[0] = c.state;
+			rec.fields[1] = c.subject;
+			rec.fields[2] = c.module;
+			rec.fields[3] = c.next_module;
+			rec.fields[4] = ReplicationRecord::quantizeProgress(c.travel_progress);
+			write(Kind::CREW, c.id, rec, 5, c.name);
+		}
+
+		const Stats& stats = station.stats;
+		// one record per vector and one for efficiency
+		static_assert(RESOURCE_COUNT <= ReplicationRecord::MAX_FIELDS);
+		const ResourceVector* vectors[] = { &stats.consumption, &stats.production, &stats.stored };
+		for (u32 v = 0; v < lengthOf(vectors); ++v) {
+			for (u32 r = 0; r < RESOURCE_COUNT; ++r) rec.fields[r] = ReplicationRecord::quantizeStat(vectors[v]->values[r], ReplicationRecord::RESOURCE_SCALE);
+			write(Kind::STATS, v, rec, RESOURCE_COUNT, nullptr);
+		}
+		rec.fields[0] = ReplicationRecord::quantizeStat(stats.efficiency, ReplicationRecord::EFFICIENCY_SCALE);
+		write(Kind::EFFICIENCY, 0, rec, 1, nullptr);
+
+		m_removed.clear();
+		for (auto iter = m_baseline.begin(), end = m_baseline.end(); iter != end; ++iter) {
+			if (iter.value().last_seen != m_tick) m_removed.push(iter.key());
+		}
+		for (u64 key : m_removed) {
+			m_baseline.erase(key);
+			writeVarint(m_message, (u64)Kind::REMOVED);
+			writeVarint(m_message, key);
+		}
+
+		writeVarint(m_message, (u64)Kind::END);
+		++m_tick;
+		return m_message;
+	}
+
+	// next message is a keyframe
+	void reset() {
+		m_baseline.clear();
+		m_tick = 0;
+	}
+
+private:
+	struct Baseline {
+		ReplicationRecord record;
+		u32 last_seen;
+	};
+
+	void write(ReplicationRecord::Kind kind, u32 id, const ReplicationRecord& rec, u32 fields_count, const char* name) {
+		const u64 key = ReplicationRecord::getKey(kind, id);
+		auto iter = m_baseline.find(key);
+		const bool is_new = !iter.isValid();
+		if (is_new) {
+			m_baseline.insert(key, Baseline());
+			iter = m_baseline.find(key);
+		}
+		Baseline& baseline = iter.value();
+		baseline.last_seen = m_tick;
+
+		u32 mask = 0;
+		for (u32 i = 0; i < fields_count; ++i) {
+			if (rec.fields[i] != baseline.record.fields[i]) mask |= 1 << i;
+		}
+		if (!is_new && mask == 0) return;
+
+		writeVarint(m_message, (u64)kind);
+		writeVarint(m_message, id);
+		writeVarint(m_message, mask);
+		for (u32 i = 0; i < fields_count; ++i) {
+			if ((mask & (1 << i)) == 0) continue;
+			writeVarint(m_message, zigzag(i32(rec.fields[i] - baseline.record.fields[i])));
+			baseline.record.fields[i] = rec.fields[i];
+		}
+		if (is_new && name) m_message.writeString(name);
+	}
+
+	HashMap<u64, Baseline> m_baseline;
+	Array<u64> m_removed;
+	OutputMemoryStream m_message;
+	u32 m_tick = 0;
+};
+
+// What a spectator reconstructs from the replication stream
+struct ReplicationMirror {
+	ReplicationMirror(IAllocator& allocator)
+		: records(allocator)
+		, crew_names(allocator)
+	{}
+
+	bool apply(InputMemoryStream& blob) {
+		using Kind = ReplicationRecord::Kind;
+		if (blob.read<u8>() != ReplicationEncoder::VERSION) return false;
+		const bool keyframe = blob.read<u8>() != 0;
+		tick = blob.read<u32>();
+		if (keyframe) {
+			records.clear();
+			crew_names.clear();
+		}
+
+		for (;;) {
+			const Kind kind = (Kind)readVarint(blob);
+			if (blob.hasOverflow()) return false;
+			if (kind == Kind::END) return true;
+			if (kind == Kind::REMOVED) {
+				const u64 key = readVarint(blob);
+				records.erase(key);
+				if (Kind(key >> 32) == Kind::CREW) crew_names.erase(u32(key));
+				continue;
+			}
+
+			const u32 id = (u32)readVarint(blob);
+			const u32 mask = (u32)readVarint(blob);
+			const u64 key = ReplicationRecord::getKey(kind, id);
+			auto iter = records.find(key);
+			const bool is_new = !iter.isValid();
+			if (is_new) {
+				records.insert(key, ReplicationRecord());
+				iter = records.find(key);
+			}
+			ReplicationRecord& rec = iter.value();
+			for (u32 i = 0; i < ReplicationRecord::MAX_FIELDS; ++i) {
+				if (mask & (1 << i)) rec.fields[i] += u32(unzigzag((u32)readVarint(blob)));
+			}
+			if (is_new && kind == Kind::CREW) crew_names.insert(id, StaticString<128>(blob.readString()));
+		}
+	}
+
+	HashMap<u64, ReplicationRecord> records;
+	HashMap<u32, StaticString<128>> crew_names;
+	u32 tick = 0;
+};
+
+struct IReplicationTransport {
+	virtual ~IReplicationTransport() {}
+	virtual bool send(Span<const u8> message) = 0;
+};
+
+// in-process spectator, for tests and benchmarks
+struct LoopbackTransport : IReplicationTransport {
+	LoopbackTransport(IAllocator& allocator) : mirror(allocator) {}
+
+	bool send(Span<const u8> message) override {
+		InputMemoryStream blob(message.begin(), message.length());
+		return mirror.apply(blob);
+	}
+
+	ReplicationMirror mirror;
+};
+
+// length-prefixed messages written to a file, which can be a named pipe read by another process
+struct FileTransport : IReplicationTransport {
+	~FileTransport() { file.close(); }
+
+	bool send(Span<const u8> message) override {
+		const u32 size = message.length();
+		return file.write(&size, sizeof(size)) && file.write(message.begin(), size);
+	}
+
+	os::OutputFile file;
+};
+
+// Counts what one subsystem owns. Allocations go through a TagAllocator, so they are tagged in the engine's
+// memory profiler too. Every block starts with a header holding its size, deallocate does not get one.
+// Not thread safe, the game allocates only on the main thread.
+struct TrackingAllocator final : IAllocator {
+	TrackingAllocator(IAllocator& parent, const char* name)
+		: name(name)
+		, m_tag(parent, name)
+	{}
+
+	void* allocate(size_t size, size_t align) override {
+		align = maximum(align, alignof(Header));
+		const size_t header_size = (sizeof(Header) + align - 1) & ~(align - 1);
+		u8* mem = (u8*)m_tag.allocate(size + header_size, align);
+		if (!mem) return nullptr;
+
+		Header* header = (Header*)(mem + header_size) - 1;
+		header->size = size;
+		header->offset = header_size;
+		live += size;
+		peak = maximum(peak, live);
+		++allocations;
+		return mem + header_size;
+	}
+
+	void deallocate(void* ptr) override {
+		if (!ptr) return;
+		const Header* header = (const Header*)ptr - 1;
+		live -= header->size;
+		m_tag.deallocate((u8*)ptr - header->offset);
+	}
+
+	void* reallocate(void* ptr, size_t new_size, size_t old_size, size_t align) override {
+		if (!ptr) return allocate(new_size, align);
+		if (new_size == 0) {
+			deallocate(ptr);
+			return nullptr;
+		}
+		void* new_ptr = allocate(new_size, align);
+		if (new_ptr) memcpy(new_ptr, ptr, minimum(new_size, old_size));
+		deallocate(ptr);
+		return new_ptr;
+	}
+
+	IAllocator* getParent() const override { return (IAllocator*)&m_tag; }
+
+	// called once per frame, allocation rate is measured over whole seconds
+	void update(float time_delta) {
+		m_rate_time += time_delta;
+		if (m_rate_time >= 1) {
+			allocation_rate = float(allocations - m_rate_allocations) / m_rate_time;
+			m_rate_allocations = allocations;
+			m_rate_time = 0;
+		}
+
+		if (budget == 0) return;
+		if (live > budget && !m_over_budget) {
+			logWarning("Memory budget of ", name, " exceeded, ", u64(live), " B used, budget is ", u64(budget), " B");
+		}
+		m_over_budget = live > budget;
+	}
+
+	const char* const name;
+	size_t live = 0;
+	size_t peak = 0;
+	size_t budget = 0; // 0 means no budget
+	u64 allocations = 0;
+	float allocation_rate = 0; // per second
+
+private:
+	struct Header {
+		size_t size;
+		size_t offset;
+	};
+
+	TagAllocator m_tag;
+	u64 m_rate_allocations = 0;
+	float m_rate_time = 0;
+	bool m_over_budget = false;
+};
+
+struct GameMemory {
+	GameMemory(IAllocator& parent)
+		: general(parent, "game")
+		, station(parent, "game station")
+		, blueprints(parent, "game blueprints")
+		, expeditions(parent, "game expeditions")
+		, gui(parent, "game gui")
+		, streaming(parent, "game streaming")
+		, replication(parent, "game replication")
+	{}
+
+	void update(float time_delta) {
+		for (TrackingAllocator* a : all) {
+			a->update(time_delta);
+			profiler::pushInt(a->name, i32(a->live >> 10)); // KiB
+		}
+	}
+
+	TrackingAllocator* find(const char* name) {
+		for (TrackingAllocator* a : all) {
+			if (equalStrings(a->name, name)) return a;
+		}
+		return nullptr;
+	}
+
+	TrackingAllocator general; // temporaries, benchmarks and anything without its own allocator
+	TrackingAllocator station;
+	TrackingAllocator blueprints;
+	TrackingAllocator expeditions;
+	TrackingAllocator gui;
+	TrackingAllocator streaming;
+	TrackingAllocator replication;
+	TrackingAllocator* const all[7] = { &general, &station, &blueprints, &expeditions, &gui, &streaming, &replication };
+};
+
+// Button callbacks stored inline in pooled slots, so registering one does not allocate once the pool has grown.
+// Slots live in fixed chunks and never move, freed slots are reused through a free list.
+// Callbacks are removed when their entity is destroyed, the entity -> slot map makes dispatch O(1).
+struct ButtonCallbacks {
+	static constexpr u32 INLINE_SIZE = 32;
+	static constexpr u32 CHUNK_SIZE = 64;
+	static constexpr u32 INVALID_SLOT = 0xffFFffFF;
+
+	ButtonCallbacks(IAllocator& allocator)
+		: m_allocator(allocator)
+		, m_chunks(allocator)
+		, m_map(allocator)
+	{}
+
+	~ButtonCallbacks() {
+		clear();
+		for (Chunk* chunk : m_chunks) LUMIX_DELETE(m_allocator, chunk);
+	}
+
+	template <typename F>
+	void set(EntityRef entity, F callback) {
+		static_assert(sizeof(F) <= INLINE_SIZE, "Callback does not fit inline, capture less");
+		static_assert(alignof(F) <= alignof(Slot), "Callback is overaligned");
+		remove(entity);
+
+		const u32 idx = allocSlot();
+		Slot& slot = getSlot(idx);
+		new (NewPlaceholder(), slot.storage) F(static_cast<F&&>(callback));
+		slot.invoke = [](void* ptr){ (*(F*)ptr)(); };
+		slot.destroy = [](void* ptr){ ((F*)ptr)->~F(); };
+		m_map.insert(entity, idx);
+	}
+
+	bool invoke(EntityRef entity) {
+		auto iter = m_map.find(entity);
+		if (!iter.isValid()) return false;
+
+		// the callback can destroy its own button, the slot is then freed after the call
+		const u32 idx = iter.value();
+		m_invoking = idx;
+		Slot& slot = getSlot(idx);
+		slot.invoke(slot.storage);
+		m_invoking = INVALID_SLOT;
+		if (m_free_after_invoke) {
+			m_free_after_invoke = false;
+			freeSlot(idx);
+		}
+		return true;
+	}
+
+	void remove(EntityRef entity) {
+		auto iter = m_map.find(entity);
+		if (!iter.isValid()) return;
+
+		const u32 idx = iter.value();
+		m_map.erase(iter);
+		if (idx == m_invoking) m_free_after_invoke = true;
+		else freeSlot(idx);
+	}
+
+	void clear() {
+		for (auto iter = m_map.begin(), end = m_map.end(); iter != end; ++iter) {
+			Slot& slot = getSlot(iter.value());
+			slot.destroy(slot.storage);
+		}
+		m_map.clear();
+		m_free = INVALID_SLOT;
+		m_used = 0;
+	}
+
+	u32 size() const { return m_map.size(); }
+	u32 capacity() const { return m_chunks.size() * CHUNK_SIZE; }
+
+private:
+	struct Slot {
+		alignas(16) u8 storage[INLINE_SIZE];
+		void (*invoke)(void*);
+		void (*destroy)(void*);
+		u32 next_free;
+	};
+
+	struct Chunk {
+		Slot slots[CHUNK_SIZE];
+	};
+
+	Slot& getSlot(u32 idx) { return m_chunks[idx / CHUNK_SIZE]->slots[idx % CHUNK_SIZE]; }
+
+	u32 allocSlot() {
+		if (m_free != INVALID_SLOT) {
+			const u32 idx = m_free;
+			m_free = getSlot(idx).next_free;
+			return idx;
+		}
+		if (m_used == capacity()) m_chunks.push(LUMIX_NEW(m_allocator, Chunk));
+		return m_used++;
+	}
+
+	void freeSlot(u32 idx) {
+		Slot& slot = getSlot(idx);
+		slot.destroy(slot.storage);
+		slot.next_free = m_free;
+		m_free = idx;
+	}
+
+	IAllocator& m_allocator;
+	Array<Chunk*> m_chunks;
+	HashMap<EntityRef, u32> m_map;
+	u32 m_used = 0; // slots ever handed out, the rest of the chunks is untouched
+	u32 m_free = INVALID_SLOT;
+	u32 m_invoking = INVALID_SLOT;
+	bool m_free_after_invoke = false;
+};
+
+// Lua update callbacks scheduled by the game instead of running every frame in their own lua_script.
+// Each script declares a rate, scripts sharing a rate are spread across frames, every call is timed
+// and a script over its budget is throttled to run less often until it gets cheap again.
+struct ScriptScheduler {
+	static constexpr u32 MAX_THROTTLE = 16; // a throttled script runs at most 16x less often than declared
+	static constexpr float DEFAULT_BUDGET_US = 250;
+
+	struct Script {
+		EntityRef entity;
+		StaticString<32> name;
+		int ref; // Lua function in the registry, LUA_NOREF once removed
+		u32 interval_frames; // 0 if `interval_ms` is used
+		float interval_ms;
+		float budget_us;
+		u32 throttle = 1;
+		u32 frames_since_run = 0;
+		float since_run = 0; // seconds
+		// stats
+		u64 calls = 0;
+		u32 over_budget = 0;
+		float avg_us = 0;
+		float max_us = 0;
+	};
+
+	ScriptScheduler(IAllocator& allocator, lua_State* L)
+		: m_scripts(allocator)
+		, m_state(L)
+	{}
+
+	~ScriptScheduler() { clear(); }
+
+	// replaces the update with the same entity and name
+	void schedule(EntityRef entity, const char* name, int ref, u32 interval_frames, float interval_ms, float budget_us) {
+		for (Script& s : m_scripts) {
+			if (s.entity == entity && s.ref != LUA_NOREF && equalStrings(s.name, name)) release(s);
+		}
+
+		Script& s = m_scripts.emplace();
+		s.entity = entity;
+		s.name = name;
+		s.ref = ref;
+		s.interval_frames = interval_frames;
+		s.interval_ms = interval_ms;
+		s.budget_us = budget_us;
+		// golden ratio sequence, consecutive scripts land far apart
+		const float spread = fmodf(m_scheduled * 0.618034f, 1.f);
+		s.frames_since_run = u32(spread * interval_frames);
+		s.since_run = (1 - spread) * interval_ms * 0.001f;
+		++m_scheduled;
+	}
+
+	void remove(EntityRef entity) {
+		for (Script& s : m_scripts) {
+			if (s.entity == entity && s.ref != LUA_NOREF) release(s);
+		}
+	}
+
+	void clear() {
+		for (Script& s : m_scripts) {
+			if (s.ref != LUA_NOREF) luaL_unref(m_state, LUA_REGISTRYINDEX, s.ref);
+		}
+		m_scripts.clear();
+	}
+
+	void update(float time_delta) {
+		PROFILE_FUNCTION();
+		m_frame_us = 0;
+		// scripts can schedule or remove other scripts, only the ones present now run and nothing is referenced across calls
+		const u32 count = m_scripts.size();
+		for (u32 i = 0; i < count; ++i) {
+			Script& s = m_scripts[i];
+			if (s.ref == LUA_NOREF) continue;
+			s.since_run += time_delta;
+			++s.frames_since_run;
+			if (!isDue(s)) continue;
+			if (m_frame_us > m_frame_budget_us) {
+				// out of time this frame, it stays due and runs in the next one
+				++m_deferred;
+				continue;
+			}
+
+			const float dt = s.since_run;
+			s.since_run = 0;
+			s.frames_since_run = 0;
+			const float us = call(s.ref, dt);
+			m_frame_us += us;
+
+			Script& after = m_scripts[i];
+			if (after.ref != LUA_NOREF) account(after, us);
+		}
+		m_scripts.eraseItems([](const Script& s){ return s.ref == LUA_NOREF; });
+		profiler::pushInt("Scheduled scripts", m_scripts.size());
+		profiler::pushInt("Scripts us", i32(m_frame_us));
+	}
+
+	Span<const Script> getScripts() const { return m_scripts; }
+	float getFrameTime() const { return m_frame_us; }
+	u32 getDeferred() const { return m_deferred; }
+	void setFrameBudget(float us) { m_frame_budget_us = us; }
+
+private:
+	bool isDue(const Script& s) const {
+		if (s.interval_frames > 0) return s.frames_since_run >= s.interval_frames * s.throttle;
+		return s.since_run * 1000 >= s.interval_ms * s.throttle;
+	}
+
+	float call(int ref, float dt) {
+		PROFILE_BLOCK("script update");
+		os::Timer timer;
+		lua_State* L = m_state;
+		lua_rawgeti(L, LUA_REGISTRYINDEX, ref); // [fn]
+		lua_pushnumber(L, dt); // [fn, dt]
+		if (lua_pcall(L, 1, 0, 0) != 0) { // []
+			logError(lua_tostring(L, -1));
+			lua_pop(L, 1);
+		}
+		return timer.getTimeSinceStart() * 1e6f;
+	}
+
+	void account(Script& s, float us) {
+		++s.calls;
+		s.avg_us = s.calls == 1 ? us : s.avg_us * 0.9f + us * 0.1f;
+		s.max_us = maximum(s.max_us, us);
+		if (us > s.budget_us) ++s.over_budget;
+
+		if (s.avg_us > s.budget_us && s.throttle < MAX_THROTTLE) {
+			s.throttle *= 2;
+			logWarning("Script ", s.name, " takes ", u32(s.avg_us), " us, budget is ", u32(s.budget_us), " us, throttled ", s.throttle, "x");
+		}
+		else if (s.throttle > 1 && s.avg_us < s.budget_us * 0.5f) {
+			s.throttle /= 2;
+		}
+	}
+
+	void release(Script& s) {
+		luaL_unref(m_state, LUA_REGISTRYINDEX, s.ref);
+		s.ref = LUA_NOREF;
+	}
+
+	Array<Script> m_scripts;
+	lua_State* m_state;
+	u32 m_scheduled = 0;
+	u32 m_deferred = 0;
+	float m_frame_us = 0;
+	float m_frame_budget_us = 2000;
+};
+
+// Writes station snapshots on its own thread. The game thread fills `beginCapture`'s buffer at a tick boundary,
+// which is a flat copy, and hands it over with `commit`; compression and the file write run on the worker,
+// which replaces the save atomically through a temporary file. A capture is possible only while the worker is idle,
+// the worker never touches game state. Buffers use the engine's thread-safe allocator, not the tracking ones.
+struct Autosave : Thread {
+	static constexpr u32 MAGIC = 0x53415645; // 'SAVE'
+	static constexpr u32 VERSION = 2;
+
+	struct Header {
+		u32 magic = MAGIC;
+		u32 version = VERSION;
+		u64 raw_size;
+	};
+
+	struct Result {
+		bool success = false;
+		u64 raw_size = 0;
+		u64 size = 0;
+		float compress_ms = 0;
+		float write_ms = 0;
+	};
+
+	Autosave(IAllocator& allocator)
+		: Thread(allocator)
+		, m_snapshot(allocator)
+		, m_compressed(allocator)
+		, m_semaphore(0, 1)
+	{}
+
+	bool start() {
+		if (m_running) return true;
+		m_quit = false;
+		m_running = create("autosave", false);
+		if (!m_running) logError("Failed to create autosave thread");
+		return m_running;
+	}
+
+	// waits for a save in progress
+	void stop() {
+		if (!m_running) return;
+		m_quit = true;
+		m_semaphore.signal();
+		destroy();
+		m_running = false;
+		m_busy = 0;
+	}
+
+	bool isRunning() const { return m_running; }
+	bool isBusy() const { return m_busy != 0; }
+
+	// nullptr while the previous snapshot is being written
+	OutputMemoryStream* beginCapture() {
+		if (!m_running || isBusy()) return nullptr;
+		m_snapshot.clear();
+		return &m_snapshot;
+	}
+
+	void commit(const char* path) {
+		ASSERT(!isBusy());
+		m_path = path;
+		// the worker never grows its buffer, allocations stay on the game thread
+		m_compressed.clear();
+		m_compressed.reserve(sizeof(Header) + getZeroRunsBound(m_snapshot.size()));
+		m_busy = 1;
+		m_semaphore.signal();
+	}
+
+	// result of the last finished save
+	const Result& getResult() {
+		if (!isBusy()) m_result = m_worker_result;
+		return m_result;
+	}
+
+	static bool read(const char* path, OutputMemoryStream& snapshot, IAllocator& allocator) {
+		os::InputFile file;
+		if (!file.open(path)) return false;
+		OutputMemoryStream data(allocator);
+		data.resize(file.size());
+		const bool res = file.read(data.getMutableData(), data.size());
+		file.close();
+		if (!res) return false;
+
+		InputMemoryStream blob(data);
+		const Header header = blob.read<Header>();
+		if (header.magic != MAGIC || header.version != VERSION) return false;
+		return decompressZeroRuns(blob, header.raw_size, snapshot);
+	}
+
+	int task() override {
+		for (;;) {
+			m_semaphore.wait();
+			if (m_quit) break;
+			m_worker_result = write();
+			m_busy = 0;
+		}
+		return 0;
+	}
+
+private:
+	Result write() {
+		PROFILE_FUNCTION();
+		Result result;
+		const double to_ms = 1000.0 / os::Timer::getFrequency();
+		u64 t = os::Timer::getRawTimestamp();
+		Header header;
+		header.raw_size = m_snapshot.size();
+		m_compressed.write(header);
+		compressZeroRuns(m_snapshot, m_compressed);
+		result.raw_size = m_snapshot.size();
+		result.size = m_compressed.size();
+		result.compress_ms = float((os::Timer::getRawTimestamp() - t) * to_ms);
+
+		t = os::Timer::getRawTimestamp();
+		const StaticString<MAX_PATH> tmp(m_path, ".tmp");
+		os::OutputFile file;
+		if (!file.open(tmp)) {
+			logError("Failed to create ", tmp);
+			return result;
+		}
+		const bool written = file.write(m_compressed.data(), m_compressed.size()) && file.flush();
+		file.close();
+		if (!written) {
+			logError("Failed to write ", tmp);
+			os::deleteFile(tmp.data);
+			return result;
+		}
+		if (!os::moveFile(tmp.data, m_path.data)) {
+			logError("Failed to replace ", m_path);
+			return result;
+		}
+		result.write_ms = float((os::Timer::getRawTimestamp() - t) * to_ms);
+		result.success = true;
+		return result;
+	}
+
+	OutputMemoryStream m_snapshot;
+	OutputMemoryStream m_compressed;
+	StaticString<MAX_PATH> m_path;
+	Semaphore m_semaphore;
+	AtomicI32 m_busy = 0;
+	volatile bool m_quit = false;
+	bool m_running = false;
+	Result m_worker_result;
+	Result m_result;
+};
+
+struct Game : ISystem {
+	Game(Engine& engine)
+		: m_engine(engine)
+		, m_assets(engine.getResourceManager(), engine.getFileSystem(), engine.getAllocator())
+	{
+		m_assets.update();
+	}
+
+	void serialize(OutputMemoryStream& stream) const override {}
+	bool deserialize(i32 version, InputMemoryStream& stream) override { return version == 0; }
+
+	void createModules(World& world) override;
+	void update(float) override { m_assets.update(); }
+
+	const char* getName() const override { return "game"; }
+
+	Engine& m_engine;
+	Assets m_assets;
+	IModule* m_lua_module = nullptr; // GameModule the Game.* Lua closures point to
+};
+
+
+struct GameModule;
+
+// Generated stations and the benchmark suite, kept out of GameModule. Each subsystem has its own benchmark,
+// `run` calls them from the tables below for every station size.
+struct StationBenchmarks {
+	struct Context {
+		GameModule& game;
+		BenchmarkReport& report;
+		u32 seed;
+		u32 size; // modules of the generated station, 0 for standalone benchmarks
+		const char* path;
+	};
+
+	struct Benchmark {
+		const char* name;
+		void (*run)(Context& ctx);
+	};
+
+	struct LuaApiCall {
+		const char* name;
+		int (*push_args)(GameModule& game, lua_State* L); // returns the number of pushed arguments
+	};
+
+	static constexpr float DT = 1 / 60.f;
+	static constexpr const char* LUA_API_BASELINE = "benchmarks/lua_api_baseline.json";
+	// allowed growth over the baseline, allocations are counted exactly, only the time depends on the machine
+	static constexpr struct { const char* suffix; double tolerance; } LUA_API_METRICS[] = {
+		{ ".ns_per_call", 0.5 },
+		{ ".lua_bytes_per_call", 0.05 },
+		{ ".native_allocs_per_call", 0 },
+	};
+
+	// on a generated station
+	static const Benchmark STATION_BENCHMARKS[];
+	// on their own data, independent of the station
+	static const Benchmark STANDALONE_BENCHMARKS[];
+
+	// Random station of `modules_count` modules attached through `hatch_` pins, with random extensions
+	// and `crew_count` crew members assigned to unfinished modules and extensions.
+	// Fails without touching the station if some module prefab is not loaded yet.
+	static bool generateStation(GameModule& game, u32 seed, u32 modules_count, u32 crew_count);
+
+	// Generates a station for each size and runs the benchmarks on it, then restores the current station.
+	// Fails if the Lua API got more expensive than its baseline or is missing from it, no baseline at all
+	// is only a warning; `update_baseline` records the baseline instead.
+	static bool run(GameModule& game, u32 seed, Span<const u32> sizes, const char* path, bool update_baseline);
+
+	static void registerLuaAPI(lua_State* L, GameModule& game);
+
+	static void benchmarkTick(Context& ctx);
+	static void benchmarkOrbit(Context& ctx);
+	static void benchmarkAutosave(Context& ctx);
+	static void benchmarkUndo(Context& ctx);
+	static void benchmarkExpeditions(Context& ctx);
+	static void benchmarkMaintenance(Context& ctx);
+	static void benchmarkReplication(Context& ctx);
+	static void benchmarkResearch(Context& ctx);
+	static void benchmarkPathfinding(Context& ctx);
+	static void benchmarkCommands(Context& ctx);
+	static void benchmarkLuaApiCosts(Context& ctx);
+	static void benchmarkGUI(Context& ctx);
+	static void benchmarkStreaming(Context& ctx);
+	static void benchmarkTemplates(Context& ctx);
+	static void benchmarkScheduler(Context& ctx);
+	static void benchmarkNeeds(Context& ctx);
+	static void benchmarkThermal(Context& ctx);
+	static void benchmarkSolar(Context& ctx);
+
+	static Module& selectBusyModule(GameModule& game);
+	static u64 getNativeAllocations(const GameModule& game);
+	static u64 getLuaMemory(lua_State* L);
+	static void benchmarkLuaApi(GameModule& game, BenchmarkReport& report, u32 iterations);
+	static u32 checkLuaApiBaseline(GameModule& game, const BenchmarkReport& report, bool update);
+
+	static int lua_generateStation(lua_State* L);
+	static int lua_restoreStation(lua_State* L);
+	static int lua_runBenchmarks(lua_State* L);
+};
+
+
+struct GameModule : IModule {
+	GameModule(Game& game, World& world) 
+		: m_memory(game.m_engine.getAllocator())
+		, m_allocator(m_memory.general)
+		, m_game(game)
+		, m_world(world)
+		, m_station(m_memory.station)
+		, m_blueprints(m_memory.blueprints)
+		, m_base_blueprints(m_memory.blueprints)
+		, m_solar(m_memory.station)
+		, m_research(m_memory.blueprints)
+		, m_active_modifiers(m_memory.blueprints)
+		, m_expeditions(m_memory.expeditions)
+		, m_supply_wheel(m_memory.expeditions)
+		, m_supply_ships(m_memory.expeditions)
+		, m_failures(m_memory.station)
+		, m_maintenance(m_memory.station)
+		, m_history(m_memory.station)
+		, m_expedition_requests(m_memory.expeditions)
+		, m_placement_requests(m_memory.station)
+		, m_replication_encoder(m_memory.replication)
+		, m_autosave(game.m_engine.getAllocator())
+		, m_fixed_blueprints(m_memory.blueprints)
+		, m_built_extensions(m_memory.blueprints)
+		, m_button_callbacks(m_memory.gui)
+		, m_scripts(m_memory.gui, game.m_engine.getState())
+		, m_streaming(m_memory.streaming)
+		, m_commands(m_memory.gui)
+		, m_command_queue(m_memory.gui)
+		, m_player_station(m_memory.station)
+	{
+		// Game.* closures point to a single module; worlds created while it lives, e.g. the editor's scratch
+		// worlds, must not take them over, the closures would dangle once such a world is destroyed
+		if (!m_game.m_lua_module) {
+			m_game.m_lua_module = this;
+			registerLuaAPI();
+		}
+
+		#define EXT(_type, _label, _volume, _material_cost, _build_time) \
+			Blueprint& _type = m_blueprints.emplace(); \
+			copyString(_type.type, #_type); \
+			copyString(_type.label, _label); \
+			_type.volume = _volume; \
+			_type.material_cost = _material_cost; \
+			_type.build_time = _build_time; \
+
+		EXT(air_recycler, "Air recycler", 5, 1000, 1);
+		air_recycler.production[StationResource::AIR] = 2000;
+		air_recycler.consumption[StationResource::POWER] = 25;
+		air_recycler.lifetime = 8 * 3600;
+		copyString(air_recycler.desc, R"#(Basic air recycler. It removes carbon dioxide from air and adds oxygen.
+It consumes 25 kJ/s of electricity.)#");
+
+		EXT(water_recycler, "Water recycler", 5, 1000, 1);
+		water_recycler.production[StationResource::WATER] = 10;
+		water_recycler.consumption[StationResource::POWER] = 25;
+		water_recycler.lifetime = 8 * 3600;
+		copyString(water_recycler.desc, R"#(Basic water recycler recycles all kinds of waste water, including urine.
+It produces drinkable water and needs 25 kJ/s of electricity to do so.)#");
+
+		EXT(solar_panel, "Solar panel", 0, 1500, 2);
+		solar_panel.production[StationResource::POWER] = 120; // avg, max is 240; only the fixed point path uses it directly, see updateSolar
+		solar_panel.prefab = Assets::SOLAR_PANEL;
+		solar_panel.lifetime = 48 * 3600;
+
+		EXT(toilet, "Toilet", 0, 500, 2);
+		toilet.consumption[StationResource::POWER] = 10;
+		toilet.lifetime = 24 * 3600;
+		copyString(toilet.desc, R"#(It's used to dispose of urine and excrements.
+The waste is stored, so it can be recycled later.
+It consumes 5 kJ/s of electricity.)#");
+
+		
+		EXT(sleeping_quarter, "Sleeping quarter", 6, 30, 1);
+		copyString(sleeping_quarter.desc, R"#(A place for one crewmember to sleep. 
+While people can sleep even without sleeping quarter, 
+it lower their health and morale considerably.)#");
+
+		EXT(hydroponics, "Hydroponics", 45, 300, 3);
+		hydroponics.production[StationResource::FOOD] = 10;
+		hydroponics.consumption[StationResource::POWER] = 250;
+		hydroponics.consumption[StationResource::WATER] = 2;
+		hydroponics.lifetime = 12 * 3600;
+		copyString(hydroponics.desc, R"#(A method of growing plants without soil, 
+by instead using mineral nutrient solutions in a water solvent.
+It consumes 10 kJ/s of electricity and 5l/day of water.
+It produces 20 000 kcal/day of food.)#");
+
+		#undef EXT
+
+		auto getBlueprint = [&](const char* type){
+			return (BlueprintHandle)m_blueprints.find([type](const Blueprint& bp){ return equalStrings(bp.type, type); });
+		};
+		// prerequisites must be declared before the projects requiring them
+		auto getResearch = [&](const char* id){
+			const i32 idx = m_research.find([id](const ResearchProject& p){ return equalStrings(p.id, id); });
+			ASSERT(idx >= 0);
+			return (u32)idx;
+		};
+
+		#define RESEARCH(_id, _label, _time, _prerequisite) \
+			ResearchProject& _id = m_research.emplace(); \
+			copyString(_id.id, #_id); \
+			copyString(_id.label, _label); \
+			_id.time = _time; \
+			_id.prerequisite = _prerequisite; \
+
+		#define MODIFIER(_project, _blueprint, _field, _op, _value) \
+			_project.modifiers[_project.modifiers_count++] = { _blueprint, Blueprint::_field, ResearchModifier::_op, _value }
+
+		RESEARCH(efficient_recyclers, "Efficient recyclers", 600, ResearchProject::NONE);
+		MODIFIER(efficient_recyclers, getBlueprint("air_recycler"), consumes(StationResource::POWER), MUL, 0.8f);
+		MODIFIER(efficient_recyclers, getBlueprint("water_recycler"), consumes(StationResource::POWER), MUL, 0.8f);
+
+		RESEARCH(improved_solar_cells, "Improved solar cells", 900, ResearchProject::NONE);
+		MODIFIER(improved_solar_cells, getBlueprint("solar_panel"), produces(StationResource::POWER), ADD, 30);
+
+		RESEARCH(modular_construction, "Modular construction", 1200, ResearchProject::NONE);
+		MODIFIER(modular_construction, ResearchModifier::ALL_BLUEPRINTS, BUILD_TIME, MUL, 0.75f);
+
+		RESEARCH(advanced_hydroponics, "Advanced hydroponics", 1800, getResearch("efficient_recyclers"));
+		MODIFIER(advanced_hydroponics, getBlueprint("hydroponics"), produces(StationResource::FOOD), MUL, 1.5f);
+		MODIFIER(advanced_hydroponics, getBlueprint("hydroponics"), consumes(StationResource::WATER), MUL, 0.8f);
+
+		#undef MODIFIER
+		#undef RESEARCH
+
+		for (const Blueprint& bp : m_blueprints) m_base_blueprints.push(bp);
+		applyResearch();
+		m_sleeping_quarter = getBlueprint("sleeping_quarter");
+		m_solar_panel = getBlueprint("solar_panel");
+
+		registerCommands();
+		m_world.entityDestroyed().bind<&GameModule::onEntityDestroyed>(this);
+	}
+
+	~GameModule() {
+		if (m_game.m_lua_module == this) m_game.m_lua_module = nullptr;
+		m_autosave.stop();
+		m_game.m_assets.cancelCallbacks(this);
+		m_world.entityDestroyed().unbind<&GameModule::onEntityDestroyed>(this);
+	}
+
+	void registerLuaAPI() {
+		lua_State* L = m_game.m_engine.getState();
+		#define REGISTER_FUNCTION(F)                                                                                    \
+			do                                                                                                          \
 			{                                                                                                           \
 				auto f = &LuaWrapper::wrapMethodClosure<&GameModule::F>; \
 				LuaWrapper::createSystemClosure(L, "Game", this, #F, f);                                              \
 			} while (false)
 
-			REGISTER_FUNCTION(getBuildProgress);
-		#undef REGISTER_FUNCTION
+			REGISTER_FUNCTION(getBuildProgress);
+		#undef REGISTER_FUNCTION
+
+		LuaWrapper::createSystemClosure(L, "Game", this, "signal", lua_signal);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getStationStats", lua_getStationStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getStatsHistory", lua_getStatsHistory);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getStatsGraph", lua_getStatsGraph);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getModule", lua_getModule);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getBlueprints", lua_getBlueprints);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getCrew", lua_getCrew);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getResearch", lua_getResearch);
+		LuaWrapper::createSystemClosure(L, "Game", this, "startExpedition", lua_startExpedition);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getExpeditions", lua_getExpeditions);
+		LuaWrapper::createSystemClosure(L, "Game", this, "forecastExpedition", lua_forecastExpedition);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getSupplyShips", lua_getSupplyShips);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getMaintenanceTasks", lua_getMaintenanceTasks);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setSupplySchedule", lua_setSupplySchedule);
+		LuaWrapper::createSystemClosure(L, "Game", this, "startReplication", lua_startReplication);
+		LuaWrapper::createSystemClosure(L, "Game", this, "stopReplication", lua_stopReplication);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getReplicationStats", lua_getReplicationStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setDeterministic", lua_setDeterministic);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getMemoryStats", lua_getMemoryStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setMemoryBudget", lua_setMemoryBudget);
+		LuaWrapper::createSystemClosure(L, "Game", this, "scheduleUpdate", lua_scheduleUpdate);
+		LuaWrapper::createSystemClosure(L, "Game", this, "unscheduleUpdates", lua_unscheduleUpdates);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getScriptStats", lua_getScriptStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setScriptFrameBudget", lua_setScriptFrameBudget);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getStateHash", lua_getStateHash);
+		LuaWrapper::createSystemClosure(L, "Game", this, "crossCheckFixedPoint", lua_crossCheckFixedPoint);
+		LuaWrapper::createSystemClosure(L, "Game", this, "assignBuilder", lua_assignBuilder);
+		LuaWrapper::createSystemClosure(L, "Game", this, "onGUIEvent", lua_onGUIEvent);
+		LuaWrapper::createSystemClosure(L, "Game", this, "benchmarkPathfinding", lua_benchmarkPathfinding);
+		LuaWrapper::createSystemClosure(L, "Game", this, "saveStationTemplate", lua_saveStationTemplate);
+		LuaWrapper::createSystemClosure(L, "Game", this, "loadStationTemplate", lua_loadStationTemplate);
+		StationBenchmarks::registerLuaAPI(L, *this);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setStreamingViewpoint", lua_setStreamingViewpoint);
+		LuaWrapper::createSystemClosure(L, "Game", this, "updateStreaming", lua_updateStreaming);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getStreamingStats", lua_getStreamingStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setStationFrame", lua_setStationFrame);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getOrbitFrameStats", lua_getOrbitFrameStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setAutosave", lua_setAutosave);
+		LuaWrapper::createSystemClosure(L, "Game", this, "autosave", lua_autosave);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getAutosaveStats", lua_getAutosaveStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "readAutosave", lua_readAutosave);
+		LuaWrapper::createSystemClosure(L, "Game", this, "loadAutosave", lua_loadAutosave);
+		LuaWrapper::createSystemClosure(L, "Game", this, "getUndoStats", lua_getUndoStats);
+		LuaWrapper::createSystemClosure(L, "Game", this, "setUndoBudget", lua_setUndoBudget);
+	}
+
+	float getBuildProgress() {
+		if (!m_selected_module) return 0;
+		return m_selected_module->build_progress;
+	}
+
+	static int lua_onGUIEvent(lua_State* L) {
+		const char* event_name = LuaWrapper::checkArg<const char*>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		game->onGUIEvent(event_name);
+		return 0;
+	}
+
+	void onGUIEvent(const char* event_name) { queueCommand(event_name); }
+
+	void registerCommand(u32 event, const GameCommand& cmd) {
+		ASSERT(!m_commands.find(event).isValid()); // name collision
+		m_commands.insert(event, cmd);
+	}
+
+	void registerCommands() {
+		registerCommand("time_0x"_event, { GameCommand::SET_TIME_MULTIPLIER, 0 });
+		registerCommand("time_1x"_event, { GameCommand::SET_TIME_MULTIPLIER, 1 });
+		registerCommand("time_2x"_event, { GameCommand::SET_TIME_MULTIPLIER, 2 });
+		registerCommand("time_4x"_event, { GameCommand::SET_TIME_MULTIPLIER, 4 });
+		registerCommand("close_module_ui"_event, { GameCommand::CLOSE_MODULE_UI });
+		registerCommand("undo"_event, { GameCommand::UNDO });
+		registerCommand("redo"_event, { GameCommand::REDO });
+
+		// GUI buttons use build_module_N, scripts signal build_moduleN
+		registerCommand("build_module_2"_event, { GameCommand::BUILD_MODULE, 2 });
+		registerCommand("build_module_3"_event, { GameCommand::BUILD_MODULE, 3 });
+		registerCommand("build_module_4"_event, { GameCommand::BUILD_MODULE, 4 });
+		registerCommand("build_module2"_event, { GameCommand::BUILD_MODULE, 2 });
+		registerCommand("build_module3"_event, { GameCommand::BUILD_MODULE, 3 });
+		registerCommand("build_module4"_event, { GameCommand::BUILD_MODULE, 4 });
+
+		for (BlueprintHandle i = 0; i < (u32)m_blueprints.size(); ++i) {
+			char event_name[64] = "build_";
+			catString(event_name, m_blueprints[i].type);
+			registerCommand(hashEvent(event_name), { GameCommand::BUILD_EXTENSION, i });
+		}
+
+		for (u32 i = 0; i < (u32)m_research.size(); ++i) {
+			char event_name[64] = "research_";
+			catString(event_name, m_research[i].id);
+			registerCommand(hashEvent(event_name), { GameCommand::START_RESEARCH, i });
+		}
+	}
+
+	// commands are applied in one batch at the start of the next simulation tick
+	void queueCommand(const char* event_name) {
+		auto iter = m_commands.find(hashEvent(event_name));
+		if (!iter.isValid()) {
+			logError("Unknown game event ", event_name);
+			return;
+		}
+		m_command_queue.push(iter.value());
+	}
+
+	void flushCommands() {
+		PROFILE_FUNCTION();
+		Assets& assets = m_game.m_assets;
+		i32 executed = 0;
+		for (const GameCommand& cmd : m_command_queue) {
+			// commands keep their order, so everything after a command waiting for its asset waits too
+			const Assets::ID asset = getRequiredAsset(cmd);
+			if (asset != Assets::NONE && !assets.isReady(asset) && !assets.isFailure(asset)) {
+				assets.request(asset);
+				break;
+			}
+			executeCommand(cmd);
+			++executed;
+		}
+		for (i32 i = executed; i < m_command_queue.size(); ++i) {
+			m_command_queue[i - executed] = m_command_queue[i];
+		}
+		m_command_queue.resize(m_command_queue.size() - executed);
+		if (m_command_queue.empty()) {
+			m_expedition_requests.clear();
+			m_placement_requests.clear();
+		}
+	}
+
+	static constexpr u32 MODULE_TYPES[] = { 2, 3 };
+
+	static Assets::ID getModuleAsset(u32 module_type) {
+		switch (module_type) {
+			case 2: return Assets::MODULE_2;
+			case 3: return Assets::MODULE_3;
+			default: return Assets::NONE;
+		}
+	}
+
+	// nullptr if the module's prefab is not ready
+	PrefabResource* getModulePrefab(u32 module_type) const {
+		return m_game.m_assets.get(getModuleAsset(module_type));
+	}
+
+	Assets::ID getRequiredAsset(const GameCommand& cmd) const {
+		switch (cmd.type) {
+			case GameCommand::BUILD_MODULE: return getModuleAsset(cmd.arg);
+			case GameCommand::BUILD_EXTENSION: return m_blueprints[cmd.arg].prefab;
+			case GameCommand::PLACE_MODULE: return getModuleAsset(m_placement_requests[cmd.arg].arg);
+			case GameCommand::PLACE_EXTENSION: return m_blueprints[m_placement_requests[cmd.arg].arg].prefab;
+			default: return Assets::NONE;
+		}
+	}
+
+	void executeCommand(const GameCommand& cmd) {
+		switch (cmd.type) {
+			case GameCommand::SET_TIME_MULTIPLIER:
+				m_time_multiplier = cmd.arg;
+				break;
+			case GameCommand::START_EXPEDITION:
+				startExpedition(m_expedition_requests[cmd.arg]);
+				break;
+			case GameCommand::CLOSE_MODULE_UI:
+				m_selected_module = nullptr;
+				break;
+			case GameCommand::UNDO:
+				undoConstruction();
+				break;
+			case GameCommand::REDO:
+				redoConstruction();
+				break;
+			case GameCommand::BUILD_MODULE: {
+				PrefabResource* prefab = getModulePrefab(cmd.arg);
+				if (!prefab) {
+					logError("Module ", cmd.arg, " is not available");
+					break;
+				}
+				cancelBuildPreview();
+				EntityMap entity_map(m_allocator);
+				m_build_ext_type = Extension::Type::HATCH;
+				if (!m_game.m_engine.instantiatePrefab(m_world, *prefab, { 0, 0, 0 }, Quat::IDENTITY, Vec3(1.f), entity_map)) break;
+				m_build_preview = entity_map.m_map[0];
+				m_build_module_type = cmd.arg;
+				break;
+			}
+			case GameCommand::START_RESEARCH: {
+				const ResearchProject& project = m_research[cmd.arg];
+				if (project.done) break;
+				if (project.prerequisite != ResearchProject::NONE && !m_research[project.prerequisite].done) {
+					logError(project.label, " requires ", m_research[project.prerequisite].label);
+					break;
+				}
+				m_active_research = cmd.arg;
+				break;
+			}
+			case GameCommand::BUILD_EXTENSION: {
+				const Blueprint& bp = m_blueprints[cmd.arg];
+				if (bp.prefab != Assets::NONE) {
+					// extensions with a prefab are placed on a free `ext_` pin by clicking, see onMouseButton
+					PrefabResource* prefab = m_game.m_assets.get(bp.prefab);
+					if (!prefab) {
+						logError(bp.type, " is not available");
+						break;
+					}
+					cancelBuildPreview();
+					EntityMap entity_map(m_allocator);
+					if (!m_game.m_engine.instantiatePrefab(m_world, *prefab, { 0, 0, 0 }, Quat::IDENTITY, Vec3(1.f), entity_map)) break;
+					m_build_preview = entity_map.m_map[0];
+					m_build_ext_type = Extension::Type::EXT;
+					m_build_blueprint = cmd.arg;
+					break;
+				}
+				if (!m_selected_module) {
+					logError("No module selected to build ", bp.type);
+					break;
+				}
+				const Extension* ext = addExtension(*m_selected_module, bp.type, INVALID_ENTITY);
+				recordAddExtension(m_station.modules.indexOf(m_selected_module), *ext);
+				break;
+			}
+			case GameCommand::PLACE_MODULE:
+			case GameCommand::PLACE_EXTENSION: {
+				const PlacementRequest& req = m_placement_requests[cmd.arg];
+				Module* m = req.module < (u32)m_station.modules.size() ? m_station.modules[req.module] : nullptr;
+				const PrefabPins* pins = m && m->id == req.module_id ? getModulePins(m->type) : nullptr;
+				const PrefabPin* pin = pins ? pins->find(req.pin) : nullptr;
+				if (!pin) {
+					logError("Pin ", req.pin, " to build on is not on the station anymore");
+					break;
+				}
+				if (cmd.type == GameCommand::PLACE_MODULE) {
+					if (Module* added = attachModule(req.module, *pin, req.arg)) recordAddModule(*added, req.module);
+					break;
+				}
+				if (getExtensionOnPin(*m, pin->name)) break;
+				const Extension* ext = addExtension(*m, req.arg, pin->name);
+				recordAddExtension(req.module, *ext);
+				break;
+			}
+		}
+	}
+
+	// clicks only queue the placement, it is applied with the other commands
+	void queuePlacement(GameCommand::Type type, Module& module, const PrefabPin& pin, u32 arg) {
+		PlacementRequest req;
+		req.module = m_station.modules.indexOf(&module);
+		req.module_id = module.id;
+		req.pin = pin.name;
+		req.arg = arg;
+		m_command_queue.push({ type, (u32)m_placement_requests.size() });
+		m_placement_requests.push(req);
+	}
+
+	void cancelBuildPreview() {
+		if (!m_build_preview.isValid()) return;
+		destroyChildren((EntityRef)m_build_preview);
+		m_world.destroyEntity((EntityRef)m_build_preview);
+		m_build_preview = INVALID_ENTITY;
+	}
+
+	i32 getBuilder(const Extension& ext) const {
+		for (const CrewMember& c : m_station.crew) {
+			if (c.subject == ext.id && c.state == CrewMember::BUILDING) return c.id;
+		}
+		return -1;
+	}
+
+	static void push(GameModule* game, lua_State* L, Extension& ext) {
+		lua_newtable(L); // [ext]
+		LuaWrapper::setField(L, -1, "id", ext.id);
+		LuaWrapper::setField(L, -1, "entity", ext.entity.index);
+		LuaWrapper::setField(L, -1, "blueprint", ext.blueprint);
+		LuaWrapper::setField(L, -1, "builder", game->getBuilder(ext));
+		LuaWrapper::setField(L, -1, "build_progress", ext.build_progress);
+		// wear is evaluated only here, when a script inspects the extension
+		const float wear = ext.getWear(game->m_game_time);
+		LuaWrapper::setField(L, -1, "wear", wear);
+		LuaWrapper::setField(L, -1, "broken", ext.broken);
+		LuaWrapper::setField(L, -1, "repair_progress", ext.repair_progress);
+		LuaWrapper::setField(L, -1, "time_to_failure", ext.wear_rate > 0 ? (1 - wear) / ext.wear_rate : -1.f);
+	}
+
+	static int lua_assignBuilder(lua_State* L) {
+		const u32 obj_id = LuaWrapper::checkArg<u32>(L, 1);
+		const u32 crewmember_id = LuaWrapper::checkArg<u32>(L, 2);
+
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		for (CrewMember& c : game->m_station.crew) {
+			if (c.id == crewmember_id) {
+				if (c.state == CrewMember::EXPEDITION) {
+					logError(c.name, " is away on an expedition and can not build or repair");
+					return 0;
+				}
+				c.state = CrewMember::BUILDING;
+				c.subject = obj_id;
+				c.subject_module = StationGraph::INVALID_NODE;
+				return 0;
+			}
+		}
+
+		logError("Invalid crewmember in assignBuilder");
+
+		return 0;
+	}
+
+	static GameModule* getClosureScene(lua_State* L) {
+		const int index = lua_upvalueindex(1);
+		if (!LuaWrapper::isType<GameModule>(L, index)) {
+			logError("Invalid Lua closure");
+			ASSERT(false);
+			return nullptr;
+		}
+		return LuaWrapper::checkArg<GameModule*>(L, index);
+	}
+
+	static int lua_getCrew(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		LuaWrapper::DebugGuard guard(L, 1);
+		const CrewNeeds& needs = game->m_station.needs;
+		ASSERT(needs.size() == (u32)game->m_station.crew.size()); // resized wherever crew joins or leaves
+		lua_newtable(L); // [crew]
+		for (const CrewMember& member : game->m_station.crew) {
+			lua_newtable(L); // [crew, member]
+			switch (member.state) {
+				case CrewMember::BUILDING: LuaWrapper::setField(L, -1, "state", "building"); break;
+				case CrewMember::IDLE: LuaWrapper::setField(L, -1, "state", "idle"); break;
+				case CrewMember::EXPEDITION: LuaWrapper::setField(L, -1, "state", "expedition"); break;
+			}
+			LuaWrapper::setField(L, -1, "subject", member.subject);
+			LuaWrapper::setField(L, -1, "id", member.id);
+			LuaWrapper::setField(L, -1, "name", member.name.data);
+			if (member.module < (u32)game->m_station.modules.size()) {
+				LuaWrapper::setField(L, -1, "module", game->m_station.modules[member.module]->id);
+			}
+			LuaWrapper::setField(L, -1, "travel_progress", member.travel_progress);
+
+			const u32 i = u32(&member - game->m_station.crew.begin());
+			LuaWrapper::setField(L, -1, "hunger", needs.get(CrewNeeds::HUNGER)[i]);
+			LuaWrapper::setField(L, -1, "thirst", needs.get(CrewNeeds::THIRST)[i]);
+			LuaWrapper::setField(L, -1, "fatigue", needs.get(CrewNeeds::FATIGUE)[i]);
+			LuaWrapper::setField(L, -1, "health", needs.get(CrewNeeds::HEALTH)[i]);
+			LuaWrapper::setField(L, -1, "morale", needs.get(CrewNeeds::MORALE)[i]);
+
+			lua_rawseti(L, -2, i + 1); // [crew]
+		}
+
+		return 1;
+	}
+
+	static int lua_getModule(lua_State* L) {
+		const EntityRef e = LuaWrapper::checkArg<EntityRef>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) {
+			ASSERT(false);
+			return 0;
+		}
+
+		const int midx = game->m_station.modules.find([&](Module* m){ return m->entity == e; });
+		if (midx < 0) {
+			ASSERT(false);
+			return 0;
+		}
+
+		LuaWrapper::DebugGuard guard(L, 1);
+		Module* m = game->m_station.modules[midx];
+		lua_newtable(L); // [module]
+		LuaWrapper::setField(L, -1, "id", m->id);
+		LuaWrapper::setField(L, -1, "entity", m->entity);
+		LuaWrapper::setField(L, -1, "build_progress", m->build_progress);
+		const ThermalField& thermal = game->m_station.thermal;
+		if ((u32)midx < thermal.size()) {
+			LuaWrapper::setField(L, -1, "temperature", thermal.getTemperatures()[midx]);
+			LuaWrapper::setField(L, -1, "thermal_efficiency", game->getThermalEfficiency(midx));
+		}
+		lua_newtable(L); // [module, exts]
+		lua_setfield(L, -2, "extensions"); // [module]
+		lua_getfield(L, -1, "extensions"); // [module, exts]
+
+		for (Extension*& ext : m->extensions) {
+			const int idx = 1 + int(&ext - m->extensions.begin());
+			push(game, L, *ext); // [module, exts, ext]
+			lua_rawseti(L, -2, idx); // [module, exts]
+		}
+		lua_pop(L, 1); // [module]
+
+		return 1;
+	}
+
+	static int lua_getBlueprints(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		lua_createtable(L, game->m_blueprints.size(), 0); // [bps]
+		for (i32 i = 0; i < game->m_blueprints.size(); ++i) {
+			const Blueprint& bp = game->m_blueprints[i];
+			lua_newtable(L); // [bps, bp]
+
+			#define EXP(T) LuaWrapper::setField(L, -1, #T, bp.T);
+			EXP(type);
+			EXP(label);
+			LuaWrapper::setField(L, -1, "prefab", bp.prefab == Assets::NONE ? "" : Assets::MANIFEST[bp.prefab].path);
+			EXP(desc);
+			const ResourceNames& names = getResourceNames();
+			for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+				LuaWrapper::setField(L, -1, names.cons[r], bp.consumption.values[r]);
+				LuaWrapper::setField(L, -1, names.prod[r], bp.production.values[r]);
+			}
+			EXP(volume);
+			EXP(material_cost);
+			EXP(build_time);
+			
+			#undef EXP
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
+	static int lua_signal(lua_State* L) {
+		const char* signal = LuaWrapper::checkArg<const char*>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+		
+		game->signal(signal);
+		return 0;
+	}
+
+	void signal(const char* value) { queueCommand(value); }
+
+	static int lua_getStationStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		lua_newtable(L);
+		const Stats& stats = game->m_station.stats;
+		const ResourceNames& names = getResourceNames();
+		for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+			LuaWrapper::setField(L, -1, names.cons[r], stats.consumption.values[r]);
+			LuaWrapper::setField(L, -1, names.prod[r], stats.production.values[r]);
+			if (!RESOURCES[r].storable) continue;
+			LuaWrapper::setField(L, -1, names.stored[r], stats.stored.values[r]);
+			LuaWrapper::setField(L, -1, names.space[r], stats.storage_space.values[r]);
+		}
+
+		LuaWrapper::setField(L, -1, "efficiency", stats.efficiency);
+		LuaWrapper::setField(L, -1, "solar_power", game->m_solar_output);
+		LuaWrapper::setField(L, -1, "sunlight", game->m_solar.getLight(game->m_angle));
+		return 1;
+	}
+
+	static void push(lua_State* L, const StatsSample& sample) {
+		lua_newtable(L); // [sample]
+		LuaWrapper::setField(L, -1, "count", sample.count);
+		if (sample.count == 0) return;
+		LuaWrapper::setField(L, -1, "min", sample.min);
+		LuaWrapper::setField(L, -1, "max", sample.max);
+		LuaWrapper::setField(L, -1, "avg", sample.sum / sample.count);
+	}
+
+	static u32 checkStatsSeries(lua_State* L, int idx) {
+		const char* name = LuaWrapper::checkArg<const char*>(L, idx);
+		const u32 series = StatsHistory::getSeries(name);
+		if (series == StatsHistory::COUNT) luaL_argerror(L, idx, "unknown stats series");
+		return series;
+	}
+
+	// Game.getStatsHistory(series, from_seconds_ago [, to_seconds_ago]) -> {min, max, avg, count}
+	static int lua_getStatsHistory(lua_State* L) {
+		const u32 series = checkStatsSeries(L, 1);
+		const float from_ago = LuaWrapper::checkArg<float>(L, 2);
+		float to_ago = 0;
+		if (lua_gettop(L) > 2) to_ago = LuaWrapper::checkArg<float>(L, 3);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		push(L, game->m_station.history.query(series, from_ago, to_ago));
+		return 1;
+	}
+
+	// Game.getStatsGraph(series, level, count) -> last `count` buckets of level 0 (second), 1 (minute) or 2 (hour)
+	static int lua_getStatsGraph(lua_State* L) {
+		const u32 series = checkStatsSeries(L, 1);
+		const u32 level = LuaWrapper::checkArg<u32>(L, 2);
+		u32 count = LuaWrapper::checkArg<u32>(L, 3);
+		if (level >= StatsHistory::LEVELS) luaL_argerror(L, 2, "invalid level");
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const StatsLevel& l = game->m_station.history.getLevel(series, level);
+		count = (u32)minimum(u64(count), minimum(l.pushed, u64(StatsLevel::CAPACITY)));
+		lua_createtable(L, count, 0); // [graph]
+		for (u32 i = 0; i < count; ++i) {
+			const u32 bucket = u32((l.pushed - count + i) % StatsLevel::CAPACITY);
+			push(L, l.tree[StatsLevel::CAPACITY + bucket]); // [graph, sample]
+			lua_rawseti(L, -2, i + 1); // [graph]
+		}
+		return 1;
+	}
+
+	ISystem& getSystem() const override { return m_game; }
+	struct World& getWorld() override { return m_world; }
+
+	void serialize(OutputMemoryStream& serializer) override {}
+	void deserialize(InputMemoryStream& serialize, const EntityMap& entity_map, i32 version) override {}
+	
+	EntityRef findByName(EntityRef parent, const char* first, const char* second) {
+		const EntityRef tmp = (EntityRef)m_world.findByName(parent, first);
+		return (EntityRef)m_world.findByName(tmp, second);
+	}
+
+	void initGUI() {
+		GUIModule* module = (GUIModule*)m_world.getModule(GUI_BUTTON_TYPE);
+		module->mousedButtonUnhandled().bind<&GameModule::onMouseButton>(this);
+
+		((GUISystem&)module->getSystem()).enableCursor(true);
+		
+		const EntityPtr gui = m_world.findByName(INVALID_ENTITY, "gui");
+		module->enableRect(*m_world.findByName(gui, "moduleui"), false);
+
+		module->buttonClicked().bind<&GameModule::onGUIButtonClicked>(this);
+	}
+
+	void onGUIButtonClicked(EntityRef entity) {
+		m_button_callbacks.invoke(entity);
+	}
+
+	void onEntityDestroyed(EntityRef entity) {
+		m_button_callbacks.remove(entity);
+		m_scripts.remove(entity);
+	}
+
+	template <typename T>
+	void setButtonCallback(EntityRef entity, T&& callback) {
+		m_button_callbacks.set(entity, static_cast<T&&>(callback));
+	}
+
+	void startGame() override {
+		m_time_multiplier = 1;
+		m_angle = PI * 0.5f;
+		m_ref_point = (EntityRef)m_world.findByName(INVALID_ENTITY, "ref_point");
+		m_camera = (EntityRef)m_world.findByName(m_ref_point, "camera");
+		m_hud = (EntityRef)m_world.findByName(m_world.findByName(INVALID_ENTITY, "gui"), "hud");
+		initOrbitFrame();
+		m_autosave.start();
+		m_autosave_settings.since = 0;
+		
+		initGUI();
+		m_is_game_started = true;
+
+		Delegate<void()> cb;
+		cb.bind<&GameModule::onCriticalAssetsReady>(this);
+		m_game.m_assets.whenReady(Assets::NONE, this, cb);
+	}
+
+	void onCriticalAssetsReady() {
+		createStartingStation();
+
+		#ifdef SPACE_GAME_BENCHMARK
+			runBenchmarksWhenReady();
+		#endif
+	}
+
+	#ifdef SPACE_GAME_BENCHMARK
+		// generated stations use every module type, not only the critical ones
+		void runBenchmarksWhenReady() {
+			for (u32 type : MODULE_TYPES) {
+				if (getModulePrefab(type)) continue;
+				Delegate<void()> cb;
+				cb.bind<&GameModule::runBenchmarksWhenReady>(this);
+				m_game.m_assets.whenReady(getModuleAsset(type), this, cb);
+				return;
+			}
+
+			const u32 sizes[] = { 10, 100, 1000 };
+			StationBenchmarks::run(*this, 1, Span(sizes, lengthOf(sizes)), "benchmark_results.json", false);
+		}
+	#endif
+
+	void initStorage() {
+		m_station.stats.stored[StationResource::WATER] = 300;
+		m_station.stats.stored[StationResource::FOOD] = 450'000;
+		m_station.stats.stored[StationResource::FUEL] = 700;
+		m_station.stats.stored[StationResource::MATERIALS] = 15300;
+	}
+
+	void createStartingStation() {
+		clearStation();
+		StationTemplate tpl(m_allocator);
+		const u32 core = tpl.addModule(2);
+		tpl.addExtension(core, "solar_panel", "ext_0", 0);
+		tpl.addExtension(core, "air_recycler");
+		tpl.addExtension(core, "toilet");
+		tpl.addExtension(core, "sleeping_quarter");
+		instantiateTemplate(tpl);
+
+		CrewMember& c0 = m_station.crew.emplace();
+		CrewMember& c1 = m_station.crew.emplace();
+		CrewMember& c2 = m_station.crew.emplace();
+		c0.id = ++m_id_generator;
+		c0.name = "Donald Trump";
+		c1.id = ++m_id_generator;
+		c1.name = "Alber Einstein";
+		c2.id = ++m_id_generator;
+		c2.name = "Vladimir Putin";
+		m_station.needs.resize(m_station.crew.size());
+
+		initStorage();
+	}
+
+	// modules, extensions and everything indexed by them; crew, research, supply, expeditions and resources stay,
+	// crew module indices are left to the caller
+	void clearModules() {
+		for (Module* m : m_station.modules) {
+			for (Extension* ext : m->extensions) LUMIX_DELETE(m_memory.station, ext);
+			destroy(m->entity);
+			LUMIX_DELETE(m_memory.station, m);
+		}
+		m_station.modules.clear();
+		m_station.graph.clear();
+		m_station.thermal.clear();
+		m_solar.forgetNormals();
+		m_solar_dirty = true;
+		m_failures.clear();
+		m_maintenance.clear();
+		m_streaming.queue.clear();
+		m_streaming.full_modules = 0;
+		m_streaming.entities = 0;
+		m_selected_module = nullptr;
+		m_history.clear();
+	}
+
+	void clearStation() {
+		clearModules();
+		m_station.crew.clear();
+		m_station.needs.clear();
+		m_expeditions.clear();
+		resetSupply();
+		m_active_modifiers.clear();
+		m_active_research = ResearchProject::NONE;
+		for (ResearchProject& p : m_research) {
+			p.progress = 0;
+			p.done = false;
+		}
+		applyResearch();
+		m_station.stats = {};
+		for (Fixed& stored : m_fixed_stored) stored = 0;
+	}
+
+	void stopGame() override {
+		// TODO clean station
+		m_is_game_started = false;
+		m_autosave.stop();
+		m_game.m_assets.cancelCallbacks(this);
+		m_scripts.clear();
+		GUIModule* scene = (GUIModule*)m_world.getModule(GUI_BUTTON_TYPE);
+		scene->mousedButtonUnhandled().unbind<&GameModule::onMouseButton>(this);
+		scene->buttonClicked().unbind<&GameModule::onGUIButtonClicked>(this);
+	}
+
+	void destroyChildren(EntityRef e) {
+		EntityPtr ch = m_world.getFirstChild(e);
+		while (ch.isValid()) {
+			const EntityRef child = (EntityRef)ch;
+			const EntityPtr next = m_world.getNextSibling(child);
+			destroyChildren(child);
+			m_world.destroyEntity(child);
+			ch = next;
+		}
+	}
+
+	EntityPtr getEntity(const char* parent, const char* child) const {
+		const EntityPtr e = m_world.findByName(INVALID_ENTITY, parent);
+		if (!e.isValid()) return INVALID_ENTITY;
+
+		return m_world.findByName(*e, child);
+	}
+
+	EntityRef findByName(EntityRef parent, const char* child) const {
+		return *m_world.findByName(parent, child);
+	}
+
+	EntityRef duplicate(EntityRef src) {
+		HashMap<EntityPtr, EntityPtr> map(m_allocator);
+		return duplicate(src, m_world.getParent(src), map);
+	}
+
+	void cloneComponent(const ComponentUID& cmp, EntityRef dst, HashMap<EntityPtr, EntityPtr>& map) {
+		m_world.createComponent(cmp.type, dst);
+
+		const reflection::ComponentBase* cmp_tpl = reflection::getComponent(cmp.type);
+	
+		PropertyCloner property_cloner;
+		property_cloner.allocator = &m_allocator;
+		property_cloner.src = cmp;
+		property_cloner.dst.type = cmp.type;
+		property_cloner.dst.entity = dst;
+		property_cloner.dst.module = cmp.module;
+		property_cloner.map = &map;
+		cmp_tpl->visit(property_cloner);
+	}
+
+	EntityRef duplicate(EntityRef src, EntityPtr parent, HashMap<EntityPtr, EntityPtr>& map) {
+		const EntityRef e = m_world.createEntity({}, {});
+		const char* name = m_world.getEntityName(src);
+		if (name[0]) m_world.setEntityName(e, name);
+
+		m_world.setParent(parent, e);
+		for (ComponentUID cmp = m_world.getFirstComponent(src); cmp.isValid(); cmp = m_world.getNextComponent(cmp)) {
+			cloneComponent(cmp, e, map);
+		}
+
+		for (EntityPtr c = m_world.getFirstChild(src); c.isValid(); c = m_world.getNextSibling(*c)) {
+			duplicate(*c, e, map);
+		}
+
+		return e;
+	}
+
+	void destroy(EntityRef e) {
+		while (EntityPtr c = m_world.getFirstChild(e)) {
+			destroy(*c);
+		}
+		m_world.destroyEntity(e);
+	}
+
+	void gridLayout(EntityRef root) {
+		GUIModule& gui_scene = getGUIModule();
+		u32 i = 0;
+		for (EntityRef c : m_world.childrenOf(root)) {
+			if (!gui_scene.isRectEnabled(c)) continue;
+
+			gui_scene.setRectTopRelative(c, 0);
+			gui_scene.setRectTopPoints(c, (i / 2) * 70.f);
+			gui_scene.setRectBottomRelative(c, 0);
+			gui_scene.setRectBottomPoints(c, (i / 2) * 70.f + 64.f);
+
+			gui_scene.setRectLeftRelative(c, (i % 2) * 0.5f);
+			gui_scene.setRectLeftPoints(c, 0);
+			gui_scene.setRectRightRelative(c, (i % 2) * 0.5f + 0.5f);
+			gui_scene.setRectRightPoints(c, 0);
+
+			++i;
+		}
+	}
+
+	void selectModule(Module& m) {
+		m_selected_module = &m;
+		const EntityRef module_ui = *getEntity("gui", "moduleui");
+		GUIModule& gui_scene = getGUIModule();
+		gui_scene.enableRect(module_ui, true);
+
+		if (m.build_progress < 1) {
+			const EntityRef templ = findByName(module_ui, "crew", "template");
+			while (EntityPtr s = m_world.getNextSibling(templ)) {
+				destroy(*s);
+			}
+
+			for (CrewMember& c : m_station.crew) {
+				const EntityRef e = duplicate(templ);
+				const EntityRef name = findByName(e, "name");
+				gui_scene.setText(name, c.name);
+				gui_scene.enableRect(e, true);
+				// ids, not pointers, crew can be reallocated before the button is clicked
+				setButtonCallback(findByName(e, "assign_button"), [this, crew_id = c.id, module_id = m.id](){
+					const i32 idx = m_station.crew.find([&](const CrewMember& c){ return c.id == crew_id; });
+					if (idx < 0) return;
+					CrewMember& c = m_station.crew[idx];
+					c.state = CrewMember::State::BUILDING;
+					c.subject = module_id;
+					c.subject_module = StationGraph::INVALID_NODE;
+				});
+			}
+
+			gui_scene.enableRect(templ, false);
+			gridLayout(*m_world.getParent(templ));
+		}
+	}
+
+	void selectModule(EntityRef e) {
+		for (Module* m : m_station.modules) {
+			if (m->entity == e) {
+				selectModule(*m);
+				return;
+			}
+
+			for (const Extension* ext : m->extensions) {
+				if (ext->entity == e) {
+					selectModule(*m);
+					return;
+				}
+			}
+		}
+	}
+	
+	// transform of a module whose `hatch_b` (relative to the module) faces `hatch_a` (in the world)
+	static Transform getNeighbourTransform(const Transform& hatch_a, const Transform& hatch_b) {
+		const Transform flip(DVec3(0), Quat(Vec3(0, 1, 0), PI), Vec3(1));
+		Transform res = hatch_a * flip * hatch_b.inverted();
+		res.rot = normalize(res.rot);
+		return res;
+	}
+
+	Transform getPinTransform(const Module& module, const PrefabPin& pin) const {
+		return m_world.getTransform(module.entity) * pin.getLocalTransform();
+	}
+
+	// true if all module types can be instantiated, the missing ones are requested otherwise
+	bool areModulePrefabsReady() {
+		bool res = true;
+		for (u32 type : MODULE_TYPES) {
+			if (getModulePins(type)) continue;
+			m_game.m_assets.request(getModuleAsset(type));
+			res = false;
+		}
+		return res;
+	}
+
+	// baked pins of the module's prefab, nullptr if the prefab is not ready;
+	// prefabs without a sidecar are scanned once from a temporary instance
+	const PrefabPins* getModulePins(u32 module_type) {
+		const Assets::ID id = getModuleAsset(module_type);
+		if (const PrefabPins* pins = m_game.m_assets.getPins(id)) return pins;
+		PrefabResource* prefab = m_game.m_assets.get(id);
+		if (!prefab) return nullptr;
+
+		EntityMap entity_map(m_allocator);
+		if (!m_game.m_engine.instantiatePrefab(m_world, *prefab, {0, 0, 0}, Quat::IDENTITY, Vec3(1.f), entity_map)) return nullptr;
+		const EntityRef root = (EntityRef)entity_map.m_map[0];
+		PrefabPins pins;
+		pins.scan(m_world, root);
+		pins.validate(Assets::MANIFEST[id].path);
+		destroyChildren(root);
+		m_world.destroyEntity(root);
+		m_game.m_assets.setPins(id, pins);
+		return m_game.m_assets.getPins(id);
+	}
+
+	const PrefabPin* getAttachHatch(u32 module_type) {
+		const PrefabPins* pins = getModulePins(module_type);
+		return pins ? pins->getAttachHatch() : nullptr;
+	}
+
+	void onMouseButton(bool down, int x, int y) {
+		PROFILE_FUNCTION();
+		const Viewport& vp = getRenderModule().getCameraViewport(m_camera);
+		DVec3 origin;
+		Vec3 dir;
+		vp.getRay(Vec2((float)x, (float)y), origin, dir);
+		const Transform ref_tr = m_world.getTransform(m_ref_point);
+		const Vec3 N = ref_tr.rot.rotate(Vec3(0, 0, 1));
+
+		if (m_build_preview.isValid()) {
+			float t;
+			if (getRayPlaneIntersecion(Vec3(origin), dir, Vec3(ref_tr.pos), N, t)) {
+				const DVec3 p = origin + dir * t;
+				if (m_build_ext_type == Extension::Type::EXT) {
+					const Pin pin = getClosestPin(p, 5, PrefabPin::Kind::EXT);
+					if (pin.module && !getExtensionOnPin(*pin.module, pin.pin->name)) {
+						queuePlacement(GameCommand::PLACE_EXTENSION, *pin.module, *pin.pin, m_build_blueprint);
+					}
+				}
+				else {
+					const Pin pin = getClosestPin(p, 5, PrefabPin::Kind::HATCH);
+					if (pin.module) queuePlacement(GameCommand::PLACE_MODULE, *pin.module, *pin.pin, m_build_module_type);
+				}
+			}
+			cancelBuildPreview();
+		}
+
+		const RayCastModelHit hit = getRenderModule().castRay(origin, dir, INVALID_ENTITY);
+		if (hit.is_hit) {
+			selectModule((EntityRef)hit.entity);
+		}
+	}
+	
+	GUIModule& getGUIModule() {
+		return *(GUIModule*)m_world.getModule(GUI_BUTTON_TYPE);
+	}
+
+	RenderModule& getRenderModule() {
+		return *(RenderModule*)m_world.getModule(MODEL_INSTANCE_TYPE);
+	}
+
+	LuaScriptModule& getLuaScene() {
+		return *(LuaScriptModule*)m_world.getModule(LUA_SCRIPT_TYPE);
+	}
+
+	// new module of `type` attached by its `hatch_0` to `parent_hatch` of the module at index `parent`,
+	// nullptr if the module's prefab is not ready
+	Module* attachModule(u32 parent, const PrefabPin& parent_hatch, u32 type) {
+		const PrefabPin* hatch = getAttachHatch(type);
+		if (!hatch) return nullptr;
+
+		Module& parent_module = *m_station.modules[parent];
+		Module* m = addModule(type);
+		if (!m) return nullptr;
+		m_world.setTransform(m->entity, getNeighbourTransform(getPinTransform(parent_module, parent_hatch), hatch->getLocalTransform()));
+		m_station.graph.connect(parent, m_station.modules.size() - 1);
+		m->parent_id = parent_module.id;
+		m->parent_hatch = parent_hatch.name;
+		m->hatch = hatch->name;
+		return m;
+	}
+
+	void recordAddModule(const Module& m, u32 parent) {
+		ConstructionHistory::Action a;
+		a.kind = ConstructionHistory::Action::ADD_MODULE;
+		a.module = m_station.modules.size() - 1;
+		a.module_id = m.id;
+		a.type = m.type;
+		a.parent = parent;
+		a.parent_hatch = m.parent_hatch;
+		a.build_progress = m.build_progress;
+		m_history.push(a);
+	}
+
+	void recordAddExtension(u32 module_idx, const Extension& ext) {
+		ConstructionHistory::Action a;
+		a.kind = ConstructionHistory::Action::ADD_EXTENSION;
+		a.module = module_idx;
+		a.module_id = m_station.modules[module_idx]->id;
+		a.extension = ext;
+		m_history.push(a);
+	}
+
+	// crew working on `subject` goes idle
+	void cancelWork(u32 subject) {
+		for (CrewMember& c : m_station.crew) {
+			if (c.state != CrewMember::BUILDING || c.subject != subject) continue;
+			c.state = CrewMember::IDLE;
+			c.subject = -1;
+			c.subject_module = StationGraph::INVALID_NODE;
+		}
+	}
+
+	void removeLastExtension(u32 module_idx) {
+		Module& m = *m_station.modules[module_idx];
+		Extension* ext = m.extensions.back();
+		cancelWork(ext->id);
+		m_failures.cancel(ext->failure);
+		if (ext->broken) m_maintenance.eraseItem(ext->id);
+		if (ext->entity.isValid()) {
+			const u32 entities = countEntities(*ext->entity);
+			destroy(*ext->entity);
+			m.entities_count -= entities;
+			m_streaming.entities -= entities;
+		}
+		m.extensions.pop();
+		LUMIX_DELETE(m_memory.station, ext);
+		m_solar_dirty = true;
+	}
+
+	// the last module must be a leaf without extensions, crew inside moves to `parent`
+	void removeLastModule(u32 parent) {
+		const u32 idx = m_station.modules.size() - 1;
+		Module* m = m_station.modules[idx];
+		ASSERT(m->extensions.empty());
+		cancelWork(m->id);
+		for (CrewMember& c : m_station.crew) {
+			if (c.subject_module == idx) c.subject_module = StationGraph::INVALID_NODE;
+			if (c.next_module == idx) c.next_module = StationGraph::INVALID_NODE;
+			if (c.module == idx) {
+				c.module = parent;
+				c.next_module = StationGraph::INVALID_NODE;
+				c.travel_progress = 0;
+			}
+		}
+
+		if (m->detail == Module::Detail::FULL) --m_streaming.full_modules;
+		if (m->detail == Module::Detail::QUEUED) m_streaming.queue.eraseItem(idx);
+		m_streaming.entities -= m->entities_count + 1;
+		if (m_selected_module == m) m_selected_module = nullptr;
+		destroy(m->entity);
+		m_station.graph.popNode();
+		m_station.modules.pop();
+		LUMIX_DELETE(m_memory.station, m);
+		m_solar_dirty = true;
+	}
 
-		LuaWrapper::createSystemClosure(L, "Game", this, "signal", lua_signal);
-		LuaWrapper::createSystemClosure(L, "Game", this, "getStationStats", lua_getStationStats);
-		LuaWrapper::createSystemClosure(L, "Game", this, "getModule", lua_getModule);
-		LuaWrapper::createSystemClosure(L, "Game", this, "getBlueprints", lua_getBlueprints);
-		LuaWrapper::createSystemClosure(L, "Game", this, "getCrew", lua_getCrew);
-		LuaWrapper::createSystemClosure(L, "Game", this, "assignBuilder", lua_assignBuilder);
-		LuaWrapper::createSystemClosure(L, "Game", this, "onGUIEvent", lua_onGUIEvent);
+	u32 countEntities(EntityRef e) const {
+		u32 count = 1;
+		for (EntityRef ch : m_world.childrenOf(e)) count += countEntities(ch);
+		return count;
+	}
 
-		#define EXT(_type, _label, _volume, _material_cost, _build_time) \
-			Blueprint& _type = m_blueprints.emplace(); \
-			copyString(_type.type, #_type); \
-			copyString(_type.label, _label); \
-			_type.volume = _volume; \
-			_type.material_cost = _material_cost; \
-			_type.build_time = _build_time; \
+	bool undoConstruction() {
+		if (!m_history.canUndo()) return false;
+		ConstructionHistory::Action& a = m_history.actions[m_history.done - 1];
+		Module* m = a.module < (u32)m_station.modules.size() ? m_station.modules[a.module] : nullptr;
+		bool valid = m && m->id == a.module_id;
+		if (valid && a.kind == ConstructionHistory::Action::ADD_MODULE) {
+			valid = a.module == (u32)m_station.modules.size() - 1 && m->extensions.empty();
+		}
+		if (valid && a.kind == ConstructionHistory::Action::ADD_EXTENSION) {
+			valid = !m->extensions.empty() && m->extensions.back()->id == a.extension.id;
+		}
+		if (!valid) {
+			logError("Construction history does not match the station anymore, it was cleared");
+			m_history.clear();
+			return false;
+		}
 
-		EXT(air_recycler, "Air recycler", 5, 1000, 1);
-		air_recycler.air_prod = 2000;
-		air_recycler.power_cons = 25;
-		copyString(air_recycler.desc, R"#(Basic air recycler. It removes carbon dioxide from air and adds oxygen.
-It consumes 25 kJ/s of electricity.)#");
+		switch (a.kind) {
+			case ConstructionHistory::Action::ADD_MODULE:
+				a.build_progress = m->build_progress;
+				removeLastModule(a.parent);
+				break;
+			case ConstructionHistory::Action::ADD_EXTENSION: {
+				a.extension = *m->extensions.back();
+				// no wear while it's undone
+				a.extension.wear_base = a.extension.getWear(m_game_time);
+				removeLastExtension(a.module);
+				break;
+			}
+		}
+		--m_history.done;
+		return true;
+	}
 
-		EXT(water_recycler, "Water recycler", 5, 1000, 1);
-		water_recycler.water_prod = 10;
-		water_recycler.power_cons = 25;
-		copyString(water_recycler.desc, R"#(Basic water recycler recycles all kinds of waste water, including urine.
-It produces drinkable water and needs 25 kJ/s of electricity to do so.)#");
+	bool redoConstruction() {
+		if (!m_history.canRedo()) return false;
+		const ConstructionHistory::Action& a = m_history.actions[m_history.done];
+		switch (a.kind) {
+			case ConstructionHistory::Action::ADD_MODULE: {
+				const PrefabPins* parent_pins = a.parent < (u32)m_station.modules.size() ? getModulePins(m_station.modules[a.parent]->type) : nullptr;
+				const PrefabPin* parent_hatch = parent_pins ? parent_pins->find(a.parent_hatch) : nullptr;
+				Module* m = parent_hatch && a.module == (u32)m_station.modules.size() ? attachModule(a.parent, *parent_hatch, a.type) : nullptr;
+				if (!m) {
+					logError("Can not redo module ", a.module_id);
+					return false;
+				}
+				m->id = a.module_id;
+				m->build_progress = a.build_progress;
+				break;
+			}
+			case ConstructionHistory::Action::ADD_EXTENSION: {
+				Module* m = a.module < (u32)m_station.modules.size() ? m_station.modules[a.module] : nullptr;
+				if (!m || m->id != a.module_id) {
+					logError("Can not redo extension ", a.extension.id);
+					return false;
+				}
+				Extension* ext = addExtension(*m, a.extension.blueprint, a.extension.pin);
+				const EntityPtr entity = ext->entity;
+				*ext = a.extension;
+				ext->entity = entity;
+				ext->failure = {};
+				ext->wear_since = m_game_time;
+				updateWear(a.module, m->extensions.size() - 1);
+				if (ext->broken) m_maintenance.push(ext->id);
+				break;
+			}
+		}
+		++m_history.done;
+		return true;
+	}
 
-		EXT(solar_panel, "Solar panel", 0, 1500, 2);
-		solar_panel.power_prod = 120; // avg, max is 240
-		solar_panel.prefab = m_game.m_assets.solar_panel;
+	Module* addModule(u32 type) {
+		PrefabResource* prefab = getModulePrefab(type);
+		if (!prefab) {
+			logError("Prefab for module ", type, " is not ready");
+			return nullptr;
+		}
+		EntityMap entity_map(m_allocator);
+		Module* m = createModule(type, *prefab, Transform::IDENTITY, entity_map);
+		m_world.setParent(m_ref_point, m->entity);
+		m_world.setLocalPosition(m->entity, {0, 0, 0});
+		return m;
+	}
 
-		EXT(toilet, "Toilet", 0, 500, 2);
-		toilet.power_cons = 10;
-		copyString(toilet.desc, R"#(It's used to dispose of urine and excrements.
-The waste is stored, so it can be recycled later.
-It consumes 5 kJ/s of electricity.)#");
+	// instantiates the module's prefab at `tr`, `entity_map` is scratch memory reused by batched callers.
+	// Once the full detail budget is used up, the module is stripped to a proxy right away, streaming expands it
+	// when the camera gets close, so a big station never has more than one module over the budget.
+	Module* createModule(u32 type, PrefabResource& prefab, const Transform& tr, EntityMap& entity_map) {
+		Module* m = LUMIX_NEW(m_memory.station, Module)(m_memory.station);
+		m->id = ++m_id_generator;
+		m->type = type;
+		entity_map.m_map.clear();
+		const bool created = m_game.m_engine.instantiatePrefab(m_world, prefab, tr.pos, tr.rot, Vec3(1.f), entity_map);
+		ASSERT(created);
+		m->entity = (EntityRef)entity_map.m_map[0];
+		m_station.modules.push(m);
+		m_station.graph.addNode();
+		++m_streaming.entities;
+		if (m_streaming.full_modules < m_streaming.max_full_modules) {
+			m->entities_count = entity_map.m_map.size() - 1;
+			m_streaming.entities += m->entities_count;
+			++m_streaming.full_modules;
+		}
+		else {
+			destroyChildren(m->entity);
+			m->detail = Module::Detail::PROXY;
+		}
+		return m;
+	}
 
-		
-		EXT(sleeping_quarter, "Sleeping quarter", 6, 30, 1);
-		copyString(sleeping_quarter.desc, R"#(A place for one crewmember to sleep. 
-While people can sleep even without sleeping quarter, 
-it lower their health and morale considerably.)#");
+	// Replaces the station's modules and extensions with `tpl` in one batch, see clearModules for what stays.
+	// Prefabs, hatches and blueprints are resolved up front,
+	// and each module is instantiated directly at its final transform, composed along the hatch chain
+	// from hatch transforms cached per module type, instead of being placed and then moved.
+	bool instantiateTemplate(const StationTemplate& tpl) {
+		PROFILE_FUNCTION();
+		if (tpl.modules.empty()) return false;
 
-		EXT(hydroponics, "Hydroponics", 45, 300, 3);
-		hydroponics.food_prod = 10;
-		hydroponics.power_cons = 250;
-		hydroponics.water_cons = 2;
-		copyString(hydroponics.desc, R"#(A method of growing plants without soil, 
-by instead using mineral nutrient solutions in a water solvent.
-It consumes 10 kJ/s of electricity and 5l/day of water.
-It produces 20 000 kcal/day of food.)#");
+		// a template spawns whole or not at all
+		for (const StationTemplate::Module& m : tpl.modules) {
+			if (!getModulePrefab(m.type) || !getModulePins(m.type)) {
+				logError("Prefab for module ", m.type, " is not ready");
+				return false;
+			}
+		}
+		for (u32 i = 0; i < (u32)tpl.modules.size(); ++i) {
+			const StationTemplate::Module& tm = tpl.modules[i];
+			if (tm.parent == StationTemplate::NO_PARENT) continue;
+			if (tm.parent >= i
+				|| !getModulePins(tpl.modules[tm.parent].type)->find(tm.parent_hatch)
+				|| !getModulePins(tm.type)->find(tm.hatch))
+			{
+				logError("Station template module ", i, " is attached by an unknown hatch");
+				return false;
+			}
+		}
+		Array<BlueprintHandle> blueprints(m_allocator);
+		blueprints.reserve(tpl.extensions.size());
+		for (const StationTemplate::Extension& e : tpl.extensions) {
+			const char* type = e.blueprint;
+			const i32 bp = m_blueprints.find([type](const Blueprint& bp){ return equalStrings(bp.type, type); });
+			if (bp < 0) {
+				logError("Unknown extension ", type, " in station template");
+				return false;
+			}
+			if (m_blueprints[bp].prefab != Assets::NONE && e.pin.data[0] == '\0') {
+				logError("Extension ", type, " in station template has no pin");
+				return false;
+			}
+			blueprints.push((BlueprintHandle)bp);
+		}
 
-		#undef EXT
+		clearModules();
+		m_station.modules.reserve(tpl.modules.size());
+
+		Array<Transform> transforms(m_allocator);
+		transforms.reserve(tpl.modules.size());
+		EntityMap entity_map(m_allocator);
+		const Transform ref_tr = m_world.getTransform(m_ref_point);
+		for (u32 i = 0; i < (u32)tpl.modules.size(); ++i) {
+			const StationTemplate::Module& tm = tpl.modules[i];
+			PrefabResource* prefab = getModulePrefab(tm.type);
+
+			Transform tr(ref_tr.pos, Quat::vec3ToVec3(Vec3(0, 1, 0), Vec3(0, 0, 1)), Vec3(1));
+			if (tm.parent != StationTemplate::NO_PARENT) {
+				const PrefabPin* hatch_a = getModulePins(tpl.modules[tm.parent].type)->find(tm.parent_hatch);
+				const PrefabPin* hatch_b = getModulePins(tm.type)->find(tm.hatch);
+				tr = getNeighbourTransform(transforms[tm.parent] * hatch_a->getLocalTransform(), hatch_b->getLocalTransform());
+			}
+			transforms.push(tr);
+
+			Module* m = createModule(tm.type, *prefab, tr, entity_map);
+			m_world.setParent(m_ref_point, m->entity);
+			m->build_progress = tm.build_progress;
+			if (tm.parent != StationTemplate::NO_PARENT) {
+				m->parent_id = m_station.modules[tm.parent]->id;
+				m->parent_hatch = tm.parent_hatch;
+				m->hatch = tm.hatch;
+				m_station.graph.connect(tm.parent, i);
+			}
+		}
+
+		for (u32 i = 0; i < (u32)tpl.extensions.size(); ++i) {
+			const StationTemplate::Extension& te = tpl.extensions[i];
+			Extension* ext = addExtension(*m_station.modules[te.module], blueprints[i], te.pin);
+			ext->build_progress = te.build_progress;
+		}
+		updateAllWear();
+		return true;
+	}
+
+	void captureTemplate(StationTemplate& tpl) const {
+		tpl.modules.clear();
+		tpl.extensions.clear();
+		HashMap<u32, u32> indices(m_allocator);
+		for (const Module* m : m_station.modules) {
+			auto parent = indices.find(m->parent_id);
+			const u32 idx = parent.isValid()
+				? tpl.addModule(m->type, parent.value(), m->parent_hatch, m->hatch)
+				: tpl.addModule(m->type);
+			tpl.modules[idx].build_progress = m->build_progress;
+			indices.insert(m->id, idx);
+			for (const Extension* ext : m->extensions) {
+				tpl.addExtension(idx, m_blueprints[ext->blueprint].type, ext->pin, ext->build_progress);
+			}
+		}
+	}
+
+	bool saveTemplate(const char* path) const {
+		StationTemplate tpl(m_allocator);
+		captureTemplate(tpl);
+		OutputMemoryStream blob(m_allocator);
+		tpl.serialize(blob);
+
+		os::OutputFile file;
+		if (!file.open(path)) {
+			logError("Failed to create ", path);
+			return false;
+		}
+		const bool res = file.write(blob.data(), blob.size());
+		file.close();
+		if (!res) logError("Failed to write ", path);
+		return res;
+	}
+
+	bool loadTemplate(const char* path) {
+		os::InputFile file;
+		if (!file.open(path)) {
+			logError("Failed to open ", path);
+			return false;
+		}
+		Array<u8> data(m_allocator);
+		data.resize((u32)file.size());
+		const bool read = file.read(data.begin(), data.size());
+		file.close();
+
+		StationTemplate tpl(m_allocator);
+		InputMemoryStream blob(data.begin(), data.size());
+		if (!read || !tpl.deserialize(blob)) {
+			logError("Invalid station template ", path);
+			return false;
+		}
+		// only modules and extensions are replaced, the crew moves in to the first module
+		// and expeditions dock there when they return
+		if (!instantiateTemplate(tpl)) return false;
+		for (CrewMember& c : m_station.crew) {
+			c.module = 0;
+			c.travel_progress = 0;
+			if (c.state == CrewMember::EXPEDITION) continue;
+			c.state = CrewMember::IDLE;
+			c.subject = c.subject_module = c.next_module = 0xffFFffFF;
+		}
+		return true;
+	}
+
+	// Game.saveStationTemplate(path) -> bool
+	static int lua_saveStationTemplate(lua_State* L) {
+		const char* path = LuaWrapper::checkArg<const char*>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		lua_pushboolean(L, game->saveTemplate(path));
+		return 1;
+	}
+
+	// Game.loadStationTemplate(path) -> bool, replaces the station, the crew stays and starts idle in the first module
+	static int lua_loadStationTemplate(lua_State* L) {
+		const char* path = LuaWrapper::checkArg<const char*>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		lua_pushboolean(L, game->loadTemplate(path));
+		return 1;
+	}
+
+	void instantiateExtension(Module& module, Extension& ext) {
+		const Blueprint& bp = m_blueprints[ext.blueprint];
+		PrefabResource* prefab = m_game.m_assets.get(bp.prefab);
+		if (!prefab) {
+			logError("Prefab for ", bp.type, " is not ready");
+			return;
+		}
+		const PrefabPins* pins = getModulePins(module.type);
+		const PrefabPin* pin = pins ? pins->find(ext.pin) : nullptr;
+		if (!pin) {
+			logError("Module ", module.type, " has no pin ", ext.pin.data, " for ", bp.type);
+			return;
+		}
+		EntityMap entity_map(m_allocator);
+		bool res = m_game.m_engine.instantiatePrefab(m_world, *prefab, {0, 0, 0}, Quat::IDENTITY, Vec3(1.f), entity_map);
+		ASSERT(res);
+		const EntityRef e = (EntityRef)entity_map.m_map[0];
+		ext.entity = e;
+		m_world.setParent(module.entity, e);
+		m_world.setLocalTransform(e, pin->getLocalTransform());
+		module.entities_count += entity_map.m_map.size();
+		m_streaming.entities += entity_map.m_map.size();
+	}
+
+	Extension* addExtension(Module& module, const char* blueprint, EntityPtr pin_e) {
+		const BlueprintHandle bp = m_blueprints.find([blueprint](const Blueprint& bp){ return equalStrings(bp.type, blueprint); });
+		ASSERT(bp != -1);
+		return addExtension(module, bp, pin_e.isValid() ? m_world.getEntityName(*pin_e) : "");
+	}
+
+	Extension* addExtension(Module& module, BlueprintHandle bp, const char* pin) {
+		Extension* ext = LUMIX_NEW(m_memory.station, Extension);
+		ext->id = ++m_id_generator;
+		ext->entity = INVALID_ENTITY;
+		ext->blueprint = bp;
+		ext->pin = pin;
+
+		if (m_blueprints[bp].prefab != Assets::NONE && module.detail == Module::Detail::FULL) {
+			instantiateExtension(module, *ext);
+		}
+
+		module.extensions.push(ext);
+		m_solar_dirty = true;
+		return ext;
+	}
+
+	// drops everything under the module's root entity, the root itself stays as a lightweight proxy
+	void collapseModule(Module& m) {
+		ASSERT(m.detail == Module::Detail::FULL);
+		if (m_selected_module == &m) return;
+
+		destroyChildren(m.entity);
+		for (Extension* ext : m.extensions) ext->entity = INVALID_ENTITY;
+		m_streaming.entities -= m.entities_count;
+		m.entities_count = 0;
+		m.detail = Module::Detail::PROXY;
+		--m_streaming.full_modules;
+		++m_streaming.collapsed_total;
+	}
+
+	void expandModule(Module& m) {
+		ASSERT(m.detail != Module::Detail::FULL);
+		PrefabResource* prefab = getModulePrefab(m.type);
+		if (!prefab) return;
+
+		// instantiate on top of the proxy, move the children under the proxy and drop the new root
+		const Transform tr = m_world.getTransform(m.entity);
+		EntityMap entity_map(m_allocator);
+		if (!m_game.m_engine.instantiatePrefab(m_world, *prefab, tr.pos, tr.rot, tr.scale, entity_map)) return;
+		const EntityRef root = (EntityRef)entity_map.m_map[0];
+		while (EntityPtr ch = m_world.getFirstChild(root)) {
+			m_world.setParent(m.entity, *ch);
+		}
+		m_world.destroyEntity(root);
+		m.entities_count = entity_map.m_map.size() - 1;
+		m_streaming.entities += m.entities_count;
+		m.detail = Module::Detail::FULL;
+		++m_streaming.full_modules;
+		m_solar_dirty = true;
+		++m_streaming.expanded_total;
+
+		for (Extension* ext : m.extensions) {
+			if (m_blueprints[ext->blueprint].prefab != Assets::NONE) instantiateExtension(m, *ext);
+		}
+	}
+
+	// checks a slice of modules against the camera each frame and expands a few of the close ones
+	void updateStreaming() {
+		PROFILE_FUNCTION();
+		ModuleStreaming& s = m_streaming;
+		const u32 count = m_station.modules.size();
+		if (count == 0) return;
+
+		// modules and the camera are children of `m_ref_point`, so distances are taken in station space
+		const DVec3 viewpoint = s.has_viewpoint ? s.viewpoint : m_world.getLocalTransform(m_camera).pos;
+		const double expand_dist2 = s.expand_distance * s.expand_distance;
+		const double collapse_dist2 = s.collapse_distance * s.collapse_distance;
+		auto getDistance2 = [&](const Module& m){
+			return squaredLength(m_world.getLocalTransform(m.entity).pos - viewpoint);
+		};
+
+		for (u32 i = 0, c = minimum(count, s.checks_per_frame); i < c; ++i) {
+			s.next_check = s.next_check % count;
+			Module& m = *m_station.modules[s.next_check];
+			++s.next_check;
+
+			const double d2 = getDistance2(m);
+			switch (m.detail) {
+				case Module::Detail::FULL: 
+					if (d2 > collapse_dist2) collapseModule(m);
+					break;
+				case Module::Detail::PROXY:
+					if (d2 < expand_dist2) {
+						m.detail = Module::Detail::QUEUED;
+						s.queue.push(m_station.modules.indexOf(&m));
+					}
+					break;
+				case Module::Detail::QUEUED: break;
+			}
+		}
+
+		for (u32 i = 0; i < s.expands_per_frame && !s.queue.empty() && s.full_modules < s.max_full_modules; ++i) {
+			// closest first
+			u32 best = 0;
+			double best_d2 = DBL_MAX;
+			for (i32 j = 0; j < s.queue.size(); ++j) {
+				const double d2 = getDistance2(*m_station.modules[s.queue[j]]);
+				if (d2 < best_d2) {
+					best_d2 = d2;
+					best = j;
+				}
+			}
+
+			Module& m = *m_station.modules[s.queue[best]];
+			s.queue.swapAndPop(best);
+			m.detail = Module::Detail::PROXY;
+			if (best_d2 < collapse_dist2) expandModule(m);
+		}
+
+		profiler::pushInt("Full modules", s.full_modules);
+		profiler::pushInt("Station entities", s.entities);
+	}
+
+	// Game.setStreamingViewpoint(x, y, z) in station space, Game.setStreamingViewpoint() to follow the camera again
+	static int lua_setStreamingViewpoint(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		ModuleStreaming& s = game->m_streaming;
+		s.has_viewpoint = lua_gettop(L) >= 3;
+		if (s.has_viewpoint) {
+			s.viewpoint.x = LuaWrapper::checkArg<double>(L, 1);
+			s.viewpoint.y = LuaWrapper::checkArg<double>(L, 2);
+			s.viewpoint.z = LuaWrapper::checkArg<double>(L, 3);
+		}
+		return 0;
+	}
+
+	// one streaming step outside of the frame update, so camera paths can be scripted headless
+	static int lua_updateStreaming(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		game->updateStreaming();
+		return 0;
+	}
+
+	static int lua_getStreamingStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const ModuleStreaming& s = game->m_streaming;
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "modules", game->m_station.modules.size());
+		LuaWrapper::setField(L, -1, "full_modules", s.full_modules);
+		LuaWrapper::setField(L, -1, "max_full_modules", s.max_full_modules);
+		LuaWrapper::setField(L, -1, "queued", s.queue.size());
+		LuaWrapper::setField(L, -1, "entities", s.entities);
+		LuaWrapper::setField(L, -1, "expanded_total", s.expanded_total);
+		LuaWrapper::setField(L, -1, "collapsed_total", s.collapsed_total);
+		return 1;
+	}
+
+	static int lua_getUndoStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const ConstructionHistory& h = game->m_history;
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "undo", h.done);
+		LuaWrapper::setField(L, -1, "redo", h.actions.size() - h.done);
+		LuaWrapper::setField(L, -1, "bytes", double(h.getBytes()));
+		LuaWrapper::setField(L, -1, "budget", double(h.budget));
+		LuaWrapper::setField(L, -1, "dropped", h.dropped);
+		return 1;
+	}
+
+	// Game.setUndoBudget(bytes), the oldest actions are dropped right away if the history is larger
+	static int lua_setUndoBudget(lua_State* L) {
+		const u32 budget = LuaWrapper::checkArg<u32>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		game->m_history.budget = budget;
+		game->m_history.trim();
+		return 0;
 	}
 
-	float getBuildProgress() {
-		if (!m_selected_module) return 0;
-		return m_selected_module->build_progress;
+	// Game.setAutosave(interval_seconds[, path]), 0 disables periodic saves, which is the default; path is relative to the data directory
+	static int lua_setAutosave(lua_State* L) {
+		const float interval = LuaWrapper::checkArg<float>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		game->m_autosave_settings.interval = interval;
+		game->m_autosave_settings.since = 0;
+		if (lua_gettop(L) > 1) game->m_autosave_settings.path = LuaWrapper::checkArg<const char*>(L, 2);
+		return 0;
+	}
+
+	// Game.autosave() -> bool, saves now unless a save is in progress
+	static int lua_autosave(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const bool queued = game->requestAutosave(game->getSavePath(game->m_autosave_settings.path));
+		if (queued) game->m_autosave_settings.since = 0;
+		lua_pushboolean(L, queued);
+		return 1;
+	}
+
+	static int lua_getAutosaveStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const AutosaveSettings& a = game->m_autosave_settings;
+		const Autosave::Result& r = game->m_autosave.getResult();
+		const FrameTimes& f = game->m_frame_times;
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "path", a.path.data);
+		LuaWrapper::setField(L, -1, "interval", a.interval);
+		LuaWrapper::setField(L, -1, "busy", game->m_autosave.isBusy());
+		LuaWrapper::setField(L, -1, "saves", a.saves);
+		LuaWrapper::setField(L, -1, "skipped", a.skipped);
+		LuaWrapper::setField(L, -1, "capture_us", a.capture_us);
+		LuaWrapper::setField(L, -1, "max_capture_us", a.max_capture_us);
+		LuaWrapper::setField(L, -1, "success", r.success);
+		LuaWrapper::setField(L, -1, "raw_bytes", double(r.raw_size));
+		LuaWrapper::setField(L, -1, "bytes", double(r.size));
+		LuaWrapper::setField(L, -1, "compress_ms", r.compress_ms);
+		LuaWrapper::setField(L, -1, "write_ms", r.write_ms);
+		LuaWrapper::setField(L, -1, "frame_avg_us_idle", f.getAvgUS(false));
+		LuaWrapper::setField(L, -1, "frame_max_us_idle", f.max_us[0]);
+		LuaWrapper::setField(L, -1, "frame_avg_us_saving", f.getAvgUS(true));
+		LuaWrapper::setField(L, -1, "frame_max_us_saving", f.max_us[1]);
+		return 1;
+	}
+
+	// Game.readAutosave(path) -> {game_time, modules, crew, raw_bytes} or nil if the save is missing or corrupted
+	static int lua_readAutosave(lua_State* L) {
+		const char* path = LuaWrapper::checkArg<const char*>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		OutputMemoryStream snapshot(game->m_allocator);
+		if (!Autosave::read(game->getSavePath(path), snapshot, game->m_allocator)) {
+			lua_pushnil(L);
+			return 1;
+		}
+		InputMemoryStream blob(snapshot);
+		const double game_time = blob.read<double>();
+		const u32 modules = blob.read<u32>();
+		const u32 crew = blob.read<u32>();
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "game_time", game_time);
+		LuaWrapper::setField(L, -1, "modules", modules);
+		LuaWrapper::setField(L, -1, "crew", crew);
+		LuaWrapper::setField(L, -1, "raw_bytes", double(snapshot.size()));
+		return 1;
+	}
+
+	// Game.loadAutosave(path) -> bool, replaces the station with the save
+	static int lua_loadAutosave(lua_State* L) {
+		const char* path = LuaWrapper::checkArg<const char*>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		lua_pushboolean(L, game->loadAutosave(path));
+		return 1;
+	}
+
+	static int lua_setStationFrame(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+		game->setStationFrame(LuaWrapper::checkArg<bool>(L, 1));
+		return 0;
+	}
+
+	static int lua_getOrbitFrameStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const OrbitFrame& f = game->m_orbit_frame;
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "station_frame", f.station_frame);
+		LuaWrapper::setField(L, -1, "transforms_updated", f.updated);
+		LuaWrapper::setField(L, -1, "transforms_avoided", f.avoided);
+		LuaWrapper::setField(L, -1, "transforms_avoided_total", double(f.avoided_total));
+		return 1;
+	}
+
+	// per resource, in the order of StationResource
+	static constexpr float MODULE_CONSUMPTION[RESOURCE_COUNT] = { 7, 10, 0, 0, 0, 0.1f, 0 }; // electronics, IR emission of the module itself
+	static constexpr float MODULE_PRODUCTION[RESOURCE_COUNT] = { 0, 5, 0, 0, 0, 0, 0 }; // heat from electronics, scaled by efficiency
+	static constexpr float MODULE_STORAGE[RESOURCE_COUNT] = { 0, 0, 200, 500000, 0, 1000, 1000 };
+	static constexpr float BASE_STORAGE[RESOURCE_COUNT] = { 0, 0, 0, 0, 0, 0, 15000 };
+	static constexpr float CREW_CONSUMPTION[RESOURCE_COUNT] = { 0, 0, 4.5f, 2700, 450, 0, 0 };
+	static constexpr float CREW_PRODUCTION[RESOURCE_COUNT] = { 0, 100, 0, 0, 0, 0, 0 };
+
+	u32 getCrewOnStation() const {
+		u32 count = 0;
+		for (const CrewMember& c : m_station.crew) {
+			if (c.state != CrewMember::EXPEDITION) ++count;
+		}
+		return count;
+	}
+
+	void computeStats(float time_delta) {
+		if (m_deterministic) {
+			computeStatsFixed(time_delta);
+			return;
+		}
+
+		Stats& stats = m_station.stats;
+		stats.production = {};
+		stats.consumption = {};
+		stats.storage_space = ResourceVector::make(BASE_STORAGE);
+
+		// power first, efficiency depends on it
+		u32 built_modules = 0;
+		for (const Module* m : m_station.modules) {
+			if (m->build_progress < 1) continue;
+			++built_modules;
+			for (Extension* ext : m->extensions) {
+				if (!ext->isWorking()) continue;
+
+				const Blueprint& bp = m_blueprints[ext->blueprint];
+				// solar panels are summed by updateSolar
+				if (ext->blueprint != m_solar_panel) stats.production[StationResource::POWER] += bp.production[StationResource::POWER];
+				stats.consumption[StationResource::POWER] += bp.consumption[StationResource::POWER];
+			}
+		}
+		stats.production[StationResource::POWER] += m_solar_output;
+		stats.consumption.addScaled(ResourceVector::make(MODULE_CONSUMPTION), float(built_modules));
+
+		const float efficiency = clamp(stats.production[StationResource::POWER] / stats.consumption[StationResource::POWER], 0.f, 1.f);
+		stats.efficiency = efficiency;
+		stats.volume = 40.f * built_modules; // usable volume in m3
+		stats.production.addScaled(ResourceVector::make(MODULE_PRODUCTION), built_modules * efficiency);
+		stats.storage_space.addScaled(ResourceVector::make(MODULE_STORAGE), float(built_modules));
+
+		// everything but power scales with efficiency
+		ResourceVector production;
+		ResourceVector consumption;
+		for (i32 module_idx = 0; module_idx < m_station.modules.size(); ++module_idx) {
+			const Module* m = m_station.modules[module_idx];
+			if (m->build_progress < 1) continue;
+			// extensions in hot modules work worse
+			const float module_efficiency = efficiency * getThermalEfficiency(module_idx);
+			for (Extension* ext : m->extensions) {
+				if (!ext->isWorking()) continue;
+				const Blueprint& bp = m_blueprints[ext->blueprint];
+				production.addScaled(bp.production, module_efficiency);
+				consumption.addScaled(bp.consumption, module_efficiency);
+			}
+		}
+		production[StationResource::POWER] = 0;
+		consumption[StationResource::POWER] = 0;
+		stats.production += production;
+		stats.consumption += consumption;
+
+		const float crew = float(getCrewOnStation());
+		stats.production.addScaled(ResourceVector::make(CREW_PRODUCTION), crew);
+		stats.consumption.addScaled(ResourceVector::make(CREW_CONSUMPTION), crew);
+
+		ResourceVector net = stats.production;
+		net -= stats.consumption;
+		stats.stored.addScaled(net, time_delta);
+		stats.stored.clamp(ResourceVector(), stats.storage_space);
 	}
 
-	static int lua_onGUIEvent(lua_State* L) {
-		const char* event_name = LuaWrapper::checkArg<const char*>(L, 1);
-		GameModule* game = getClosureScene(L);
-		if (!game) return 0;
-
-		game->onGUIEvent(event_name);
-		return 0;
+	// hot modules slow their extensions down, except in deterministic mode: temperatures are floats,
+	// so the fixed point path leaves the penalty out and the heat follows it
+	float getThermalEfficiency(u32 module_idx) const {
+		return m_deterministic ? 1 : m_station.thermal.getEfficiency(module_idx);
 	}
 
-	void onGUIEvent(const char* event_name) {
-		const RuntimeHash event_hash(event_name);
-		static const RuntimeHash time_0x_event("time_0x");
-		static const RuntimeHash time_1x_event("time_1x");
-		static const RuntimeHash time_2x_event("time_2x");
-		static const RuntimeHash time_4x_event("time_4x");
+	// computeStats in fixed point, bit-identical on every platform, without the hot module penalty.
+	// Solar panels count with the blueprint's average output, updateSolar's per-panel sum is a float.
+	// Extension sums are per-blueprint counts dotted with the fixed point blueprint columns,
+	// plain integer loops over contiguous arrays the compiler vectorizes without changing the result.
+	void computeStatsFixed(float time_delta) {
+		PROFILE_FUNCTION();
+		const u32 bp_count = m_blueprints.size();
+		m_built_extensions.resize(bp_count);
+		memset(m_built_extensions.begin(), 0, bp_count * sizeof(m_built_extensions[0]));
 
-		static const RuntimeHash build_module_2_event("build_module_2");
-		static const RuntimeHash build_module_3_event("build_module_3");
-		static const RuntimeHash build_module_4_event("build_module_4");
-		static const RuntimeHash build_solar_panel_event("build_solar_panel");
-		
-		if (event_hash == time_0x_event) {
-			m_time_multiplier = 0;
-			return;
-		}
-		if (event_hash == time_1x_event) {
-			m_time_multiplier = 1;
-			return;
-		}
-		if (event_hash == time_2x_event) {
-			m_time_multiplier = 2;
-			return;
+		Fixed built_modules = 0;
+		for (const Module* m : m_station.modules) {
+			if (m->build_progress < 1) continue;
+			++built_modules;
+			for (const Extension* ext : m->extensions) {
+				if (ext->isWorking()) ++m_built_extensions[ext->blueprint];
+			}
 		}
-		if (event_hash == time_4x_event) {
-			m_time_multiplier = 4;
-			return;
+		const Fixed crew = getCrewOnStation();
+
+		Fixed sums[Blueprint::FIELD_COUNT];
+		const Fixed* counts = m_built_extensions.begin();
+		for (u32 f = 0; f < Blueprint::FIELD_COUNT; ++f) {
+			const Fixed* column = &m_fixed_blueprints[f * bp_count];
+			Fixed sum = 0;
+			for (u32 bp = 0; bp < bp_count; ++bp) sum += column[bp] * counts[bp];
+			sums[f] = sum;
 		}
-		
-		if (event_hash == build_module_2_event) {
-			ASSERT(!m_build_preview.isValid());
-			EntityMap entity_map(m_allocator);
-			const bool created = m_game.m_engine.instantiatePrefab(m_world, *m_game.m_assets.module_2, {0, 0, 0}, Quat::IDENTITY, Vec3(1.f), entity_map);
-			m_build_preview = entity_map.m_map[0];
-			m_build_prefab = m_game.m_assets.module_2;
-			return;
+
+		const u32 power = (u32)StationResource::POWER;
+		const Fixed power_prod = sums[Blueprint::produces(StationResource::POWER)];
+		const Fixed power_cons = sums[Blueprint::consumes(StationResource::POWER)] + toFixed(MODULE_CONSUMPTION[power]) * built_modules;
+		const Fixed efficiency = power_cons > 0 ? clamp(divFixed(power_prod, power_cons), Fixed(0), FIXED_ONE) : FIXED_ONE;
+
+		Stats& stats = m_station.stats;
+		stats.efficiency = fromFixed(efficiency);
+		stats.volume = fromFixed(40 * FIXED_ONE * built_modules);
+		const Fixed dt = toFixed(time_delta);
+		for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+			// everything but power scales with efficiency
+			const Fixed scale = r == power ? FIXED_ONE : efficiency;
+			const Fixed production = mulFixed(sums[Blueprint::produces(StationResource(r))], scale)
+				+ mulFixed(toFixed(MODULE_PRODUCTION[r]) * built_modules, efficiency)
+				+ toFixed(CREW_PRODUCTION[r]) * crew;
+			const Fixed consumption = mulFixed(sums[Blueprint::consumes(StationResource(r))], scale)
+				+ toFixed(MODULE_CONSUMPTION[r]) * built_modules
+				+ toFixed(CREW_CONSUMPTION[r]) * crew;
+			const Fixed space = toFixed(BASE_STORAGE[r]) + toFixed(MODULE_STORAGE[r]) * built_modules;
+
+			// stored amounts live in fixed point, a float that no longer matches was changed outside, e.g. by an expedition
+			Fixed& stored = m_fixed_stored[r];
+			if (stats.stored.values[r] != fromFixed(stored)) stored = toFixed(stats.stored.values[r]);
+			stored = clamp(stored + mulFixed(dt, production - consumption), Fixed(0), space);
+
+			stats.production.values[r] = fromFixed(production);
+			stats.consumption.values[r] = fromFixed(consumption);
+			stats.storage_space.values[r] = fromFixed(space);
+			stats.stored.values[r] = fromFixed(stored);
 		}
-		if (event_hash == build_module_3_event) {
-			ASSERT(!m_build_preview.isValid());
-			EntityMap entity_map(m_allocator);
-			const bool created = m_game.m_engine.instantiatePrefab(m_world, *m_game.m_assets.module_3, {0, 0, 0}, Quat::IDENTITY, Vec3(1.f), entity_map);
-			m_build_preview = entity_map.m_map[0];
-			m_build_prefab = m_game.m_assets.module_3;
-			return;
+	}
+
+	// progress += dt / duration, returns true when finished;
+	// deterministic mode advances in whole 1/2^24 steps, which floats below 1 hold exactly
+	bool advanceProgress(float& progress, float dt, float duration) const {
+		if (m_deterministic) {
+			static constexpr double PROGRESS_ONE = 1 << 24;
+			const Fixed fixed_duration = toFixed(duration);
+			if (fixed_duration <= 0) {
+				progress = 1;
+				return true;
+			}
+			const i64 value = i64(progress * PROGRESS_ONE) + (toFixed(dt) << 24) / fixed_duration;
+			progress = float(value / PROGRESS_ONE);
 		}
-		if (event_hash == build_module_4_event) {
-			ASSERT(!m_build_preview.isValid());
-			EntityMap entity_map(m_allocator);
-			const bool created = m_game.m_engine.instantiatePrefab(m_world, *m_game.m_assets.module_4, {0, 0, 0}, Quat::IDENTITY, Vec3(1.f), entity_map);
-			m_build_preview = entity_map.m_map[0];
-			m_build_prefab = m_game.m_assets.module_4;
-			return;
+		else {
+			progress += dt / duration;
 		}
-		if (event_hash == build_solar_panel_event) {
-			ASSERT(false);
-			/*ASSERT(!m_build_preview.isValid());
-			EntityMap entity_map(m_allocator);
-			const bool created = m_game.m_engine.instantiatePrefab(m_world, *m_game.m_assets.solar_panel, {0, 0, 0}, Quat::IDENTITY, 1.f, Ref(entity_map));
-			m_build_preview = entity_map.m_map[0];
-			m_build_prefab = m_game.m_assets.solar_panel;
-			m_build_ext_type = Extension::Type::SOLAR_PANEL;*/
-			return;
+		return progress >= 1;
+	}
+
+	// lockstep peers and the server compare this after each tick
+	u64 getStateHash() const {
+		u64 hash = 14695981039346656037ull;
+		auto mix = [&](const void* data, u32 size) {
+			for (u32 i = 0; i < size; ++i) {
+				hash ^= ((const u8*)data)[i];
+				hash *= 1099511628211ull;
+			}
+		};
+		mix(m_fixed_stored, sizeof(m_fixed_stored));
+		for (const Module* m : m_station.modules) {
+			mix(&m->build_progress, sizeof(m->build_progress));
+			for (const Extension* ext : m->extensions) mix(&ext->build_progress, sizeof(ext->build_progress));
 		}
-		if (startsWith(event_name, "build_")) {
-			addExtension(*m_selected_module, event_name + stringLength("build_"), INVALID_ENTITY);
-			return;
+		for (const CrewMember& c : m_station.crew) {
+			mix(&c.state, sizeof(c.state));
+			mix(&c.module, sizeof(c.module));
+			mix(&c.travel_progress, sizeof(c.travel_progress));
 		}
-		ASSERT(false);
+		return hash;
 	}
 
-	i32 getBuilder(const Extension& ext) const {
-		for (const CrewMember& c : m_station.crew) {
-			if (c.subject == ext.id && c.state == CrewMember::BUILDING) return c.id;
+	struct CrossCheckResult {
+		float max_error = 0;
+		const char* series = "";
+		u64 hash = 0;
+		bool reproducible = false;
+	};
+
+	// Runs the same generated station through the float and the fixed point path and reports the largest
+	// relative difference of the stats, then reruns the fixed point path to check it's bit-identical.
+	// Solar power differs by design, the float path sums the panels' actual output and the fixed point path
+	// uses the blueprint's average, and so does everything scaled by efficiency; hot modules make the float
+	// path produce less, the fixed point path has no hot module penalty.
+	// The current station is restored afterwards.
+	CrossCheckResult crossCheckFixedPoint(u32 seed, u32 modules_count, u32 crew_count, u32 ticks) {
+		PROFILE_FUNCTION();
+		OutputMemoryStream station(m_allocator);
+		captureSnapshot(station);
+		const bool deterministic = m_deterministic;
+		const float dt = 1 / 60.f;
+		auto run = [&](bool fixed_point, float (&values)[StatsHistory::COUNT]) {
+			StationBenchmarks::generateStation(*this, seed, modules_count, crew_count);
+			m_deterministic = fixed_point;
+			for (u32 i = 0; i < ticks; ++i) simulate(dt);
+			StatsHistory::gather(m_station.stats, values);
+			return getStateHash();
+		};
+
+		CrossCheckResult res;
+		float float_values[StatsHistory::COUNT];
+		float fixed_values[StatsHistory::COUNT];
+		run(false, float_values);
+		res.hash = run(true, fixed_values);
+		for (u32 i = 0; i < StatsHistory::COUNT; ++i) {
+			const float error = fabsf(float_values[i] - fixed_values[i]) / maximum(1.f, fabsf(float_values[i]));
+			if (error > res.max_error) {
+				res.max_error = error;
+				res.series = StatsHistory::getSeriesName(i);
+			}
 		}
-		return -1;
+		res.reproducible = run(true, fixed_values) == res.hash;
+		m_deterministic = deterministic;
+		restoreStation(station);
+		return res;
 	}
 
-	static void push(GameModule* game, lua_State* L, Extension& ext) {
-		lua_newtable(L); // [ext]
-		LuaWrapper::setField(L, -1, "id", ext.id);
-		LuaWrapper::setField(L, -1, "entity", ext.entity.index);
-		LuaWrapper::setField(L, -1, "blueprint", ext.blueprint);
-		LuaWrapper::setField(L, -1, "builder", game->getBuilder(ext));
-		LuaWrapper::setField(L, -1, "build_progress", ext.build_progress);
+	// Game.crossCheckFixedPoint(seed, modules, crew, ticks)
+	static int lua_crossCheckFixedPoint(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const u32 seed = LuaWrapper::checkArg<u32>(L, 1);
+		const u32 modules_count = LuaWrapper::checkArg<u32>(L, 2);
+		const u32 crew_count = LuaWrapper::checkArg<u32>(L, 3);
+		const u32 ticks = LuaWrapper::checkArg<u32>(L, 4);
+		if (!game->areModulePrefabsReady()) return luaL_error(L, "module prefabs are not loaded yet");
+		const CrossCheckResult res = game->crossCheckFixedPoint(seed, modules_count, crew_count, ticks);
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "max_error", res.max_error);
+		LuaWrapper::setField(L, -1, "series", res.series);
+		LuaWrapper::setField(L, -1, "reproducible", res.reproducible);
+		return 1;
 	}
 
-	static int lua_assignBuilder(lua_State* L) {
-		const u32 obj_id = LuaWrapper::checkArg<u32>(L, 1);
-		const u32 crewmember_id = LuaWrapper::checkArg<u32>(L, 2);
+	// Game.setDeterministic(bool), stats in fixed point and progress in whole steps, for lockstep multiplayer;
+	// hot modules do not slow their extensions down while it's on
+	static int lua_setDeterministic(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		game->m_deterministic = LuaWrapper::checkArg<bool>(L, 1);
+		return 0;
+	}
 
+	// as a hex string, Lua numbers can not hold all 64 bits
+	static int lua_getStateHash(lua_State* L) {
 		GameModule* game = getClosureScene(L);
 		if (!game) return 0;
 
-		for (CrewMember& c : game->m_station.crew) {
-			if (c.id == crewmember_id) {
-				c.state = CrewMember::BUILDING;
-				c.subject = obj_id;
-				return 0;
+		char tmp[32];
+		sprintf_s(tmp, "%016llx", (unsigned long long)game->getStateHash());
+		lua_pushstring(L, tmp);
+		return 1;
+	}
+
+	u32 findSubjectModule(u32 subject) const {
+		for (i32 i = 0; i < m_station.modules.size(); ++i) {
+			const Module* m = m_station.modules[i];
+			if (m->id == subject) return i;
+			for (const Extension* ext : m->extensions) {
+				if (ext->id == subject) return i;
 			}
 		}
+		return StationGraph::INVALID_NODE;
+	}
 
-		logError("Invalid crewmember in assignBuilder");
+	// walks through hatches towards the subject's module, returns true once the crew member is there
+	bool moveCrewMember(CrewMember& c, float time_delta) {
+		static constexpr float MODULE_TRAVERSAL_TIME = 5.f; // seconds from one hatch to the next one
 
-		return 0;
+		if (c.module == c.subject_module) return true;
+
+		if (c.next_module == StationGraph::INVALID_NODE) {
+			c.next_module = m_station.graph.getNextHop(c.module, c.subject_module);
+			if (c.next_module == StationGraph::INVALID_NODE) return false;
+			c.travel_progress = 0;
+		}
+
+		if (advanceProgress(c.travel_progress, time_delta, MODULE_TRAVERSAL_TIME)) {
+			c.module = c.next_module;
+			c.next_module = StationGraph::INVALID_NODE;
+			c.travel_progress = 0;
+		}
+		return c.module == c.subject_module;
 	}
 
-	static GameModule* getClosureScene(lua_State* L) {
-		const int index = lua_upvalueindex(1);
-		if (!LuaWrapper::isType<GameModule>(L, index)) {
-			logError("Invalid Lua closure");
-			ASSERT(false);
-			return nullptr;
+	// Re-bases the extension's wear at the current game time and predicts its breakdown.
+	// Called only when the extension starts or stops working, wear in between is computed from the timestamps.
+	void updateWear(u32 module_idx, u32 ext_idx) {
+		const Module& m = *m_station.modules[module_idx];
+		Extension& ext = *m.extensions[ext_idx];
+		ext.wear_base = ext.getWear(m_game_time);
+		ext.wear_since = m_game_time;
+		m_failures.cancel(ext.failure);
+		ext.failure = {};
+
+		// every extension and every repair gets its own lifetime around the blueprint's one
+		const float lifetime = m_blueprints[ext.blueprint].lifetime * (0.5f + randomFloatAt(ext.id, ext.repairs));
+		const bool working = m.build_progress >= 1 && ext.isWorking();
+		ext.wear_rate = working && lifetime > 0 ? 1 / lifetime : 0;
+		if (ext.wear_rate == 0) return;
+
+		const double failure_time = m_game_time + (1 - ext.wear_base) / ext.wear_rate;
+		ext.failure = m_failures.schedule(toTimerTicks(failure_time), ExtensionFailure{ module_idx, ext_idx }.toPayload());
+	}
+
+	// after the station is built or loaded in one go
+	void updateAllWear() {
+		PROFILE_FUNCTION();
+		m_failures.clear();
+		for (u32 i = 0; i < (u32)m_station.modules.size(); ++i) {
+			const Module* m = m_station.modules[i];
+			for (u32 j = 0; j < (u32)m->extensions.size(); ++j) {
+				m->extensions[j]->failure = {};
+				updateWear(i, j);
+			}
 		}
-		return LuaWrapper::checkArg<GameModule*>(L, index);
 	}
 
-	static int lua_getCrew(lua_State* L) {
+	void onExtensionFailure(const ExtensionFailure& failure) {
+		if (failure.module_idx >= (u32)m_station.modules.size()) return;
+		const Module& m = *m_station.modules[failure.module_idx];
+		if (failure.ext_idx >= (u32)m.extensions.size()) return;
+
+		Extension& ext = *m.extensions[failure.ext_idx];
+		ext.failure = {};
+		ext.broken = true;
+		ext.repair_progress = 0;
+		updateWear(failure.module_idx, failure.ext_idx);
+		m_maintenance.push(ext.id);
+		if (ext.blueprint == m_solar_panel) m_solar_dirty = true;
+	}
+
+	void repairExtension(u32 module_idx, u32 ext_idx) {
+		Extension& ext = *m_station.modules[module_idx]->extensions[ext_idx];
+		ext.broken = false;
+		ext.repair_progress = 0;
+		ext.wear_base = 0;
+		ext.wear_rate = 0;
+		++ext.repairs;
+		updateWear(module_idx, ext_idx);
+		m_maintenance.eraseItem(ext.id);
+		if (ext.blueprint == m_solar_panel) m_solar_dirty = true;
+	}
+
+	// cost depends on the number of breakdowns, not on the number of extensions
+	void updateMaintenance() {
+		PROFILE_FUNCTION();
+		m_failures.advance(u32(m_game_time / TIMER_TICK), [this](u64 payload){
+			onExtensionFailure(ExtensionFailure::fromPayload(payload));
+		});
+	}
+
+	// Game.getMaintenanceTasks() -> { { id, type, module, repair_progress, builder }, ... }, broken extensions in order of breakdown
+	static int lua_getMaintenanceTasks(lua_State* L) {
 		GameModule* game = getClosureScene(L);
 		if (!game) return 0;
 
-		LuaWrapper::DebugGuard guard(L, 1);
-		lua_newtable(L); // [crew]
-		for (const CrewMember& member : game->m_station.crew) {
-			lua_newtable(L); // [crew, member]
-			switch (member.state) {
-				case CrewMember::BUILDING: LuaWrapper::setField(L, -1, "state", "building"); break;
-				case CrewMember::IDLE: LuaWrapper::setField(L, -1, "state", "idle"); break;
+		lua_newtable(L); // [tasks]
+		i32 i = 0;
+		for (u32 ext_id : game->m_maintenance) {
+			const u32 module_idx = game->findSubjectModule(ext_id);
+			if (module_idx == StationGraph::INVALID_NODE) continue;
+			const Module* m = game->m_station.modules[module_idx];
+			for (Extension* ext : m->extensions) {
+				if (ext->id != ext_id) continue;
+				lua_newtable(L); // [tasks, task]
+				LuaWrapper::setField(L, -1, "id", ext->id);
+				LuaWrapper::setField(L, -1, "type", (const char*)game->m_blueprints[ext->blueprint].type);
+				LuaWrapper::setField(L, -1, "module", m->entity);
+				LuaWrapper::setField(L, -1, "repair_progress", ext->repair_progress);
+				LuaWrapper::setField(L, -1, "builder", game->getBuilder(*ext));
+				lua_rawseti(L, -2, ++i); // [tasks]
+				break;
 			}
-			LuaWrapper::setField(L, -1, "subject", member.subject);
-			LuaWrapper::setField(L, -1, "id", member.id);
-			LuaWrapper::setField(L, -1, "name", member.name.data);
-
-			const int idx = 1 + int(&member - game->m_station.crew.begin());
-			lua_rawseti(L, -2, idx); // [crew]
 		}
-
 		return 1;
 	}
 
-	static int lua_getModule(lua_State* L) {
-		const EntityRef e = LuaWrapper::checkArg<EntityRef>(L, 1);
-		GameModule* game = getClosureScene(L);
-		if (!game) {
-			ASSERT(false);
-			return 0;
-		}
+	void updateCrew(float time_delta) {
+		PROFILE_FUNCTION();
+		m_station.graph.beginTick();
+		const float dt = time_delta * m_time_multiplier;
+		m_idle_crew = 0;
+		m_station.needs.resize(m_station.crew.size());
+		float* active = m_station.needs.get(CrewNeeds::ACTIVE);
+		for (CrewMember& c : m_station.crew) {
+			active[&c - m_station.crew.begin()] = c.state == CrewMember::IDLE ? 0.f : 1.f;
+			if (c.state != CrewMember::BUILDING) {
+				if (c.state == CrewMember::IDLE) ++m_idle_crew;
+				continue;
+			}
 
-		const int midx = game->m_station.modules.find([&](Module* m){ return m->entity == e; });
-		if (midx < 0) {
-			ASSERT(false);
-			return 0;
-		}
+			if (c.subject_module == StationGraph::INVALID_NODE) {
+				c.subject_module = findSubjectModule(c.subject);
+				if (c.subject_module == StationGraph::INVALID_NODE) {
+					c.state = CrewMember::IDLE;
+					continue;
+				}
+			}
 
-		LuaWrapper::DebugGuard guard(L, 1);
-		Module* m = game->m_station.modules[midx];
-		lua_newtable(L); // [module]
-		LuaWrapper::setField(L, -1, "id", m->id);
-		LuaWrapper::setField(L, -1, "entity", m->entity);
-		LuaWrapper::setField(L, -1, "build_progress", m->build_progress);
-		lua_newtable(L); // [module, exts]
-		lua_setfield(L, -2, "extensions"); // [module]
-		lua_getfield(L, -1, "extensions"); // [module, exts]
+			// travel time counts toward build time, crew builds only once it's in the module
+			if (!moveCrewMember(c, dt)) continue;
 
-		for (Extension*& ext : m->extensions) {
-			const int idx = 1 + int(&ext - m->extensions.begin());
-			push(game, L, *ext); // [module, exts, ext]
-			lua_rawseti(L, -2, idx); // [module, exts]
+			Module* m = m_station.modules[c.module];
+			if (m->id == c.subject) {
+				if (advanceProgress(m->build_progress, dt, 100)) {
+					m->build_progress  = 1;
+					c.state = CrewMember::IDLE;
+					m_solar_dirty = true;
+					for (u32 i = 0; i < (u32)m->extensions.size(); ++i) updateWear(c.module, i);
+				}
+				continue;
+			}
+			for (u32 i = 0; i < (u32)m->extensions.size(); ++i) {
+				Extension* ext = m->extensions[i];
+				if (ext->id != c.subject) continue;
+
+				const float build_time = m_blueprints[ext->blueprint].build_time;
+				if (ext->broken) {
+					// a repair takes a quarter of the build
+					if (advanceProgress(ext->repair_progress, dt, 5 * build_time)) {
+						repairExtension(c.module, i);
+						c.state = CrewMember::IDLE;
+						c.subject = -1;
+					}
+				}
+				else if (ext->build_progress < 1 && advanceProgress(ext->build_progress, dt, 20 * build_time)) {
+					ext->build_progress  = 1;
+					c.state = CrewMember::IDLE;
+					c.subject = -1;
+					m_solar_dirty = true;
+					updateWear(c.module, i);
+				}
+				else if (ext->build_progress >= 1) {
+					c.state = CrewMember::IDLE;
+					c.subject = -1;
+				}
+				break;
+			}
 		}
-		lua_pop(L, 1); // [module]
-
-		return 1;
+		profiler::pushInt("Path queries", (i32)m_station.graph.m_queries);
+		profiler::pushInt("Route builds", m_station.graph.m_builds_this_tick);
 	}
 
-	static int lua_getBlueprints(lua_State* L) {
-		GameModule* game = getClosureScene(L);
-		if (!game) return 0;
-
-		lua_createtable(L, game->m_blueprints.size(), 0); // [bps]
-		for (i32 i = 0; i < game->m_blueprints.size(); ++i) {
-			const Blueprint& bp = game->m_blueprints[i];
-			lua_newtable(L); // [bps, bp]
+	// panel normals relative to the orbiting ref point, panels face their local +Y
+	void rebuildSolarPanels() {
+		PROFILE_FUNCTION();
+		m_solar.clear();
+		const Quat to_station = m_world.getRotation(m_ref_point).conjugated();
+		for (const Module* m : m_station.modules) {
+			if (m->build_progress < 1) continue;
+			for (const Extension* ext : m->extensions) {
+				if (ext->blueprint != m_solar_panel || !ext->isWorking()) continue;
 
-			#define EXP(T) LuaWrapper::setField(L, -1, #T, bp.T);
-			EXP(type);
-			EXP(label);
-			EXP(prefab);
-			EXP(desc);
-			EXP(power_cons);
-			EXP(power_prod);
-			EXP(heat_cons);
-			EXP(heat_prod);
-			EXP(water_cons);
-			EXP(water_prod);
-			EXP(food_cons);
-			EXP(food_prod);
-			EXP(air_cons);
-			EXP(air_prod);
-			EXP(volume);
-			EXP(material_cost);
-			EXP(build_time);
-			
-			#undef EXP
-			lua_rawseti(L, -2, i + 1);
+				Vec3 normal;
+				if (ext->entity.isValid()) {
+					normal = to_station.rotate(m_world.getRotation((EntityRef)ext->entity).rotate(Vec3(0, 1, 0)));
+					m_solar.setKnownNormal(ext->id, normal);
+				}
+				else if (!m_solar.getKnownNormal(ext->id, normal)) {
+					normal = to_station.rotate(m_world.getRotation(m->entity).rotate(Vec3(0, 1, 0)));
+				}
+				m_solar.push(normal, 2 * m_blueprints[ext->blueprint].production[StationResource::POWER]);
+			}
 		}
-		return 1;
+		m_solar_dirty = false;
 	}
 
-	static int lua_signal(lua_State* L) {
-		const char* signal = LuaWrapper::checkArg<const char*>(L, 1);
-		GameModule* game = getClosureScene(L);
-		if (!game) return 0;
-		
-		game->signal(signal);
-		return 0;
+	// averaged over the arc of the orbit since the last tick, m_angle advances in update()
+	void updateSolar(float time_delta) {
+		if (m_solar_dirty) rebuildSolarPanels();
+		const float arc = m_time_multiplier * time_delta * 0.2f;
+		m_solar_output = m_solar.getOutput(m_angle - arc, m_angle);
 	}
 
-	void signal(const char* value) {
-		if (equalStrings(value, "close_module_ui")) m_selected_module = nullptr;
-		else if (equalStrings(value, "build_module2")) {
-			ASSERT(!m_build_preview.isValid());
-			EntityMap entity_map(m_allocator);
-			m_build_ext_type = Extension::Type::HATCH;
-			const bool created = m_game.m_engine.instantiatePrefab(m_world, *m_game.m_assets.module_2, { 0, 0, 0 }, Quat::IDENTITY, Vec3(1.f), entity_map);
-			m_build_preview = entity_map.m_map[0];
-			m_build_prefab = m_game.m_assets.module_2;
-			return;
+	// heat sources per module, same terms as the station-wide heat in computeStats
+	void updateThermal(float time_delta) {
+		PROFILE_FUNCTION();
+		ThermalField& thermal = m_station.thermal;
+		thermal.syncLinks(m_station.graph);
+		float* heat = thermal.getHeat();
+		const float efficiency = m_station.stats.efficiency;
+		for (i32 i = 0; i < m_station.modules.size(); ++i) {
+			const Module* m = m_station.modules[i];
+			heat[i] = 0;
+			if (m->build_progress < 1) continue;
+			const float module_efficiency = efficiency * getThermalEfficiency(i);
+			heat[i] = 5 * efficiency;
+			for (const Extension* ext : m->extensions) {
+				if (!ext->isWorking()) continue;
+				const Blueprint& bp = m_blueprints[ext->blueprint];
+				heat[i] += (bp.production[StationResource::HEAT] - bp.consumption[StationResource::HEAT]) * module_efficiency;
+			}
 		}
-		else if (equalStrings(value, "build_module3")) {
-			ASSERT(!m_build_preview.isValid());
-			EntityMap entity_map(m_allocator);
-			const bool created = m_game.m_engine.instantiatePrefab(m_world, *m_game.m_assets.module_3, { 0, 0, 0 }, Quat::IDENTITY, Vec3(1.f), entity_map);
-			m_build_preview = entity_map.m_map[0];
-			m_build_prefab = m_game.m_assets.module_3;
-			return;
+		for (const CrewMember& c : m_station.crew) {
+			if (c.state != CrewMember::EXPEDITION) heat[c.module] += 100;
 		}
-		else if (equalStrings(value, "build_module4")) {
-			ASSERT(!m_build_preview.isValid());
-			EntityMap entity_map(m_allocator);
-			const bool created = m_game.m_engine.instantiatePrefab(m_world, *m_game.m_assets.module_4, { 0, 0, 0 }, Quat::IDENTITY, Vec3(1.f), entity_map);
-			m_build_preview = entity_map.m_map[0];
-			m_build_prefab = m_game.m_assets.module_4;
-			return;
+		thermal.step(time_delta * m_time_multiplier);
+
+		u32 hot_modules = 0;
+		const float* temperatures = thermal.getTemperatures();
+		for (u32 i = 0; i < thermal.size(); ++i) {
+			if (temperatures[i] > ThermalField::HOT_TEMPERATURE) ++hot_modules;
 		}
+		profiler::pushInt("Hot modules", hot_modules);
 	}
 
-	static int lua_getStationStats(lua_State* L) {
-		GameModule* game = getClosureScene(L);
-		if (!game) return 0;
+	// per second rates: a day without food or three without water before needs turn harmful,
+	// a crew member builds 16 hours on full rest and rests 8 hours, twice as long without a bed
+	static CrewNeeds::Rates getNeedsRates(float time_delta, bool has_food, bool has_water, u32 missing_beds) {
+		CrewNeeds::Rates rates;
+		rates.hunger = has_food ? -time_delta / 600 : time_delta / (24 * 3600);
+		rates.thirst = has_water ? -time_delta / 600 : time_delta / (3 * 24 * 3600);
+		rates.fatigue_active = time_delta / (16 * 3600);
+		rates.fatigue_rest = time_delta / (missing_beds > 0 ? 16 * 3600 : 8 * 3600);
+		rates.heal = time_delta / (24 * 3600);
+		rates.damage = time_delta / 3600;
+		rates.morale = minimum(time_delta / 3600, 1.f);
+		rates.morale_penalty = missing_beds > 0 ? 0.2f : 0.f;
+		return rates;
+	}
 
-		lua_newtable(L);
-		const Stats& stats = game->m_station.stats;
-		LuaWrapper::setField(L, -1, "power_cons", stats.consumption.power);
-		LuaWrapper::setField(L, -1, "power_prod", stats.production.power);
-		LuaWrapper::setField(L, -1, "heat_cons", stats.consumption.heat);
-		LuaWrapper::setField(L, -1, "heat_prod", stats.production.heat);
-		LuaWrapper::setField(L, -1, "water_cons", stats.consumption.water);
-		LuaWrapper::setField(L, -1, "water_prod", stats.production.water);
-		LuaWrapper::setField(L, -1, "food_cons", stats.consumption.food);
-		LuaWrapper::setField(L, -1, "food_prod", stats.production.food);
-		LuaWrapper::setField(L, -1, "air_cons", stats.consumption.air);
-		LuaWrapper::setField(L, -1, "air_prod", stats.production.air);
-		LuaWrapper::setField(L, -1, "fuel_cons", stats.consumption.fuel);
-		
-		LuaWrapper::setField(L, -1, "water_stored", stats.stored.water);
-		LuaWrapper::setField(L, -1, "food_stored", stats.stored.food);
-		LuaWrapper::setField(L, -1, "fuel_stored", stats.stored.fuel);
-		LuaWrapper::setField(L, -1, "materials_stored", stats.stored.materials);
-
-		LuaWrapper::setField(L, -1, "water_space", stats.storage_space.water);
-		LuaWrapper::setField(L, -1, "food_space", stats.storage_space.food);
-		LuaWrapper::setField(L, -1, "fuel_space", stats.storage_space.fuel);
-		LuaWrapper::setField(L, -1, "materials_space", stats.storage_space.materials);
-		
-		LuaWrapper::setField(L, -1, "efficiency", stats.efficiency);
-		return 1;
+	void updateNeeds(float time_delta) {
+		PROFILE_FUNCTION();
+		u32 beds = 0;
+		for (const Module* m : m_station.modules) {
+			if (m->build_progress < 1) continue;
+			for (const Extension* ext : m->extensions) {
+				if (ext->blueprint == m_sleeping_quarter && ext->isWorking()) ++beds;
+			}
+		}
+		const u32 crew = m_station.crew.size();
+		const Stats& stats = m_station.stats;
+		m_station.needs.resize(crew);
+		m_station.needs.update(getNeedsRates(time_delta * m_time_multiplier, stats.stored[StationResource::FOOD] > 0, stats.stored[StationResource::WATER] > 0, crew > beds ? crew - beds : 0));
 	}
 
-	ISystem& getSystem() const override { return m_game; }
-	struct World& getWorld() override { return m_world; }
+	// effective blueprints are the base ones with all finished research applied,
+	// so nothing is recomputed per tick, only when research finishes
+	void applyResearch() {
+		PROFILE_FUNCTION();
+		const u32 count = m_base_blueprints.size();
+		float add[Blueprint::FIELD_COUNT] = {};
+		float mul[Blueprint::FIELD_COUNT];
+		for (BlueprintHandle bp = 0; bp < count; ++bp) {
+			for (float& m : mul) m = 1;
+			for (float& a : add) a = 0;
+			for (const ResearchModifier& m : m_active_modifiers) {
+				if (m.blueprint != bp && m.blueprint != ResearchModifier::ALL_BLUEPRINTS) continue;
+				if (m.op == ResearchModifier::ADD) add[m.field] += m.value;
+				else mul[m.field] *= m.value;
+			}
 
-	void serialize(OutputMemoryStream& serializer) override {}
-	void deserialize(InputMemoryStream& serialize, const EntityMap& entity_map, i32 version) override {}
-	
-	EntityRef findByName(EntityRef parent, const char* first, const char* second) {
-		const EntityRef tmp = (EntityRef)m_world.findByName(parent, first);
-		return (EntityRef)m_world.findByName(tmp, second);
+			Blueprint& dst = m_blueprints[bp];
+			const Blueprint& src = m_base_blueprints[bp];
+			for (u32 f = 0; f < Blueprint::FIELD_COUNT; ++f) {
+				const Blueprint::Field field = (Blueprint::Field)f;
+				dst[field] = (src[field] + add[f]) * mul[f];
+			}
+		}
+
+		m_fixed_blueprints.resize(count * Blueprint::FIELD_COUNT);
+		for (u32 f = 0; f < Blueprint::FIELD_COUNT; ++f) {
+			for (BlueprintHandle bp = 0; bp < count; ++bp) {
+				m_fixed_blueprints[f * count + bp] = toFixed(m_blueprints[bp][(Blueprint::Field)f]);
+			}
+		}
 	}
 
-	void initGUI() {
-		GUIModule* module = (GUIModule*)m_world.getModule(GUI_BUTTON_TYPE);
-		module->mousedButtonUnhandled().bind<&GameModule::onMouseButton>(this);
+	void startExpedition(const ExpeditionRequest& request) {
+		const float legs = float(u32(request.duration / Expedition::LEG_DURATION));
+		const float fuel = legs * Expedition::FUEL_PER_LEG * request.crew_count;
+		if (request.crew_count == 0 || legs == 0) {
+			logError("Expedition needs crew and at least ", Expedition::LEG_DURATION, " s");
+			return;
+		}
+		if (fuel > m_station.stats.stored[StationResource::FUEL]) {
+			logError("Not enough fuel for the expedition, ", fuel, " needed");
+			return;
+		}
 
-		((GUISystem&)module->getSystem()).enableCursor(true);
-		
-		const EntityPtr gui = m_world.findByName(INVALID_ENTITY, "gui");
-		module->enableRect(*m_world.findByName(gui, "moduleui"), false);
+		CrewMember* crew[Expedition::MAX_CREW];
+		for (u32 i = 0; i < request.crew_count; ++i) {
+			const i32 idx = m_station.crew.find([&](const CrewMember& c){ return c.id == request.crew[i]; });
+			if (idx < 0 || m_station.crew[idx].state == CrewMember::EXPEDITION) {
+				logError("Crew member ", request.crew[i], " can not join the expedition");
+				return;
+			}
+			crew[i] = &m_station.crew[idx];
+		}
 
-		module->buttonClicked().bind<&GameModule::onGUIButtonClicked>(this);
+		Expedition& e = m_expeditions.emplace();
+		e.id = ++m_id_generator;
+		e.key = randomAt(m_expedition_seed, e.id);
+		e.duration = request.duration;
+		e.crew_count = request.crew_count;
+		for (u32 i = 0; i < request.crew_count; ++i) {
+			e.crew[i] = crew[i]->id;
+			crew[i]->state = CrewMember::EXPEDITION;
+			crew[i]->subject = -1;
+			crew[i]->next_module = StationGraph::INVALID_NODE;
+		}
+		m_station.stats.stored[StationResource::FUEL] -= fuel;
 	}
 
-	void onGUIButtonClicked(EntityRef entity) {
-		auto iter = m_button_callbacks.find(entity);
-		if (iter.isValid()) iter.value()->invoke();
-	}
+	void finishExpedition(const Expedition& e) {
+		Stats& stats = m_station.stats;
+		stats.stored[StationResource::MATERIALS] += e.outcome.materials;
+		stats.stored[StationResource::FUEL] += e.outcome.fuel;
 
-	template <typename T>
-	void setButtonCallback(EntityRef entity, T&& callback) {
-		struct MyCallback : ButtonCallback {
-			MyCallback(T&& callback) 
-				: callback(static_cast<T&&>(callback))
-			{}
+		// everybody docks at the first module
+		for (u32 i = 0; i < e.crew_count; ++i) {
+			for (CrewMember& c : m_station.crew) {
+				if (c.id != e.crew[i]) continue;
+				c.state = CrewMember::IDLE;
+				c.module = 0;
+				c.travel_progress = 0;
+			}
+		}
 
-			void invoke() override { callback(); }
+		for (u32 i = 0; i < e.outcome.recruits; ++i) {
+			CrewMember& c = m_station.crew.emplace();
+			c.id = ++m_id_generator;
+			c.name = StaticString<128>("Recruit ", c.id);
+		}
+		m_station.needs.resize(m_station.crew.size());
+		logInfo("Expedition returned with ", e.outcome.materials, " materials, ", e.outcome.fuel, " fuel and ", e.outcome.recruits, " recruits");
+	}
 
-			T callback;
+	void updateExpeditions(float time_delta) {
+		PROFILE_FUNCTION();
+		static constexpr i32 PARALLEL_THRESHOLD = 256;
+		const float dt = time_delta * m_time_multiplier;
+
+		auto step = [&](i32 from, i32 to) {
+			for (i32 i = from; i < to; ++i) {
+				Expedition& e = m_expeditions[i];
+				e.elapsed += dt;
+				const u32 legs = minimum(u32(e.elapsed / Expedition::LEG_DURATION), e.getLegsCount());
+				for (; e.legs_done < legs; ++e.legs_done) {
+					Expedition::simulateLeg(e.key, e.legs_done, e.crew_count, e.outcome);
+				}
+			}
 		};
 
-		UniquePtr<ButtonCallback> ptr = UniquePtr<MyCallback>::create(m_allocator, static_cast<T&&>(callback));
-		m_button_callbacks.insert(entity, ptr.move());
+		// every expedition touches only its own data
+		if (m_expeditions.size() < PARALLEL_THRESHOLD) step(0, m_expeditions.size());
+		else jobs::forEach(m_expeditions.size(), 64, step);
+
+		// returns are applied serially, in order
+		for (i32 i = 0; i < m_expeditions.size(); ) {
+			if (m_expeditions[i].elapsed >= m_expeditions[i].duration) {
+				finishExpedition(m_expeditions[i]);
+				m_expeditions.erase(i);
+			}
+			else {
+				++i;
+			}
+		}
 	}
 
-	void startGame() override {
-		m_time_multiplier = 1;
-		m_angle = PI * 0.5f;
-		m_ref_point = (EntityRef)m_world.findByName(INVALID_ENTITY, "ref_point");
-		m_camera = (EntityRef)m_world.findByName(m_ref_point, "camera");
-		m_hud = (EntityRef)m_world.findByName(m_world.findByName(INVALID_ENTITY, "gui"), "hud");
-		
-		Module* m = addModule(*m_game.m_assets.module_2);
-		m_world.setRotation(m->entity, Quat::vec3ToVec3(Vec3(0, 1, 0), Vec3(0, 0, 1)));
-		m->build_progress = 1;
-		
-		const EntityPtr pin_e = m_world.findByName(m->entity, "ext_0");
-		addExtension(*m, "solar_panel", pin_e)->build_progress = 0;
-		addExtension(*m, "air_recycler", INVALID_ENTITY)->build_progress = 1;
-		addExtension(*m, "toilet", INVALID_ENTITY)->build_progress = 1;
-		addExtension(*m, "sleeping_quarter", INVALID_ENTITY)->build_progress = 1;
-		CrewMember& c0 = m_station.crew.emplace();
-		CrewMember& c1 = m_station.crew.emplace();
-		CrewMember& c2 = m_station.crew.emplace();
-		c0.id = ++m_id_generator;
-		c0.name = "Donald Trump";
-		c1.id = ++m_id_generator;
-		c1.name = "Alber Einstein";
-		c2.id = ++m_id_generator;
-		c2.name = "Vladimir Putin";
+	static constexpr float TIMER_TICK = 0.25f; // seconds of game time, resolution of the timing wheels
 
-		m_station.stats.stored.water = 300;
-		m_station.stats.stored.food = 450'000;
-		m_station.stats.stored.fuel = 700;
-		m_station.stats.stored.materials = 15300;
+	static u32 toTimerTicks(double time) { return u32(minimum(ceil(time / TIMER_TICK), double(0xffFFffFF))); }
 
-		initGUI();
-		m_is_game_started = true;
-	}
+	enum class SupplyEvent : u8 {
+		ARRIVAL,
+		DELIVERY,
+		DEPARTURE
+	};
 
-	void stopGame() override {
-		// TODO clean station
-		m_is_game_started = false;
-		GUIModule* scene = (GUIModule*)m_world.getModule(GUI_BUTTON_TYPE);
-		scene->mousedButtonUnhandled().unbind<&GameModule::onMouseButton>(this);
-		scene->buttonClicked().unbind<&GameModule::onGUIButtonClicked>(this);
+	// relative to the wheel's time, while events fire it's the time of the current event, not the end of the frame
+	void scheduleSupplyEvent(SupplyShip& ship, SupplyEvent event, float delay) {
+		ship.next_event_time = m_supply_wheel.now() * double(TIMER_TICK) + delay;
+		ship.next_event = m_supply_wheel.schedule(toTimerTicks(ship.next_event_time), (u64(ship.id) << 8) | u64(event));
 	}
 
-	void destroyChildren(EntityRef e) {
-		EntityPtr ch = m_world.getFirstChild(e);
-		while (ch.isValid()) {
-			const EntityRef child = (EntityRef)ch;
-			const EntityPtr next = m_world.getNextSibling(child);
-			destroyChildren(child);
-			m_world.destroyEntity(child);
-			ch = next;
-		}
+	// launches a ship arriving in `delay` seconds
+	void scheduleSupplyShip(float delay) {
+		SupplyShip ship;
+		ship.id = ++m_id_generator;
+		ship.cargo = m_supply.cargo;
+		scheduleSupplyEvent(ship, SupplyEvent::ARRIVAL, delay);
+		m_supply_ships.insert(ship.id, ship);
 	}
 
-	EntityPtr getEntity(const char* parent, const char* child) const {
-		const EntityPtr e = m_world.findByName(INVALID_ENTITY, parent);
-		if (!e.isValid()) return INVALID_ENTITY;
-
-		return m_world.findByName(*e, child);
+	void onSupplyEvent(u32 ship_id, SupplyEvent event) {
+		auto iter = m_supply_ships.find(ship_id);
+		if (!iter.isValid()) return;
+
+		SupplyShip& ship = iter.value();
+		switch (event) {
+			case SupplyEvent::ARRIVAL:
+				ship.state = SupplyShip::DOCKED;
+				scheduleSupplyEvent(ship, SupplyEvent::DELIVERY, m_supply.unload_time);
+				// the next ship leaves the ground as this one docks, so arrivals keep their cadence; `ship` is invalidated
+				scheduleSupplyShip(m_supply.interval);
+				break;
+			case SupplyEvent::DELIVERY:
+				// whatever doesn't fit is dropped by the storage clamp in computeStats
+				m_station.stats.stored += ship.cargo;
+				ship.state = SupplyShip::UNLOADED;
+				scheduleSupplyEvent(ship, SupplyEvent::DEPARTURE, m_supply.undock_time);
+				break;
+			case SupplyEvent::DEPARTURE:
+				m_supply_ships.erase(iter);
+				break;
+		}
 	}
 
-	EntityRef findByName(EntityRef parent, const char* child) const {
-		return *m_world.findByName(parent, child);
+	// events are fired at their own game time, a big time step still delivers every ship in order
+	void updateSupply() {
+		PROFILE_FUNCTION();
+		m_supply_wheel.advance(u32(m_game_time / TIMER_TICK), [this](u64 payload){
+			onSupplyEvent(u32(payload >> 8), SupplyEvent(payload & 0xff));
+		});
 	}
 
-	EntityRef duplicate(EntityRef src) {
-		HashMap<EntityPtr, EntityPtr> map(m_allocator);
-		return duplicate(src, m_world.getParent(src), map);
+	void resetSupply() {
+		m_supply_wheel.clear();
+		m_supply_ships.clear();
+		m_game_time = 0;
+		scheduleSupplyShip(m_supply.interval);
 	}
 
-	void cloneComponent(const ComponentUID& cmp, EntityRef dst, HashMap<EntityPtr, EntityPtr>& map) {
-		m_world.createComponent(cmp.type, dst);
+	// Game.getSupplyShips() -> { { id, state, eta }, ... }, eta is the game time until the ship's next event
+	static int lua_getSupplyShips(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		const reflection::ComponentBase* cmp_tpl = reflection::getComponent(cmp.type);
-	
-		PropertyCloner property_cloner;
-		property_cloner.allocator = &m_allocator;
-		property_cloner.src = cmp;
-		property_cloner.dst.type = cmp.type;
-		property_cloner.dst.entity = dst;
-		property_cloner.dst.module = cmp.module;
-		property_cloner.map = &map;
-		cmp_tpl->visit(property_cloner);
+		static const char* STATE_NAMES[] = { "en_route", "docked", "unloaded" };
+		lua_newtable(L); // [ships]
+		i32 i = 0;
+		for (const SupplyShip& ship : game->m_supply_ships) {
+			lua_newtable(L); // [ships, ship]
+			LuaWrapper::setField(L, -1, "id", ship.id);
+			LuaWrapper::setField(L, -1, "state", STATE_NAMES[ship.state]);
+			LuaWrapper::setField(L, -1, "eta", float(ship.next_event_time - game->m_game_time));
+			lua_rawseti(L, -2, ++i); // [ships]
+		}
+		return 1;
 	}
 
-	EntityRef duplicate(EntityRef src, EntityPtr parent, HashMap<EntityPtr, EntityPtr>& map) {
-		const EntityRef e = m_world.createEntity({}, {});
-		const char* name = m_world.getEntityName(src);
-		if (name[0]) m_world.setEntityName(e, name);
-
-		m_world.setParent(parent, e);
-		for (ComponentUID cmp = m_world.getFirstComponent(src); cmp.isValid(); cmp = m_world.getNextComponent(cmp)) {
-			cloneComponent(cmp, e, map);
-		}
+	// Game.setSupplySchedule({ interval, unload_time, undock_time, <resource> = amount, ... }), missing fields are kept,
+	// applies to ships launched from now on
+	static int lua_setSupplySchedule(lua_State* L) {
+		LuaWrapper::checkTableArg(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		for (EntityPtr c = m_world.getFirstChild(src); c.isValid(); c = m_world.getNextSibling(*c)) {
-			duplicate(*c, e, map);
+		SupplySchedule& supply = game->m_supply;
+		LuaWrapper::getOptionalField(L, 1, "interval", &supply.interval);
+		LuaWrapper::getOptionalField(L, 1, "unload_time", &supply.unload_time);
+		LuaWrapper::getOptionalField(L, 1, "undock_time", &supply.undock_time);
+		for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+			LuaWrapper::getOptionalField(L, 1, RESOURCES[r].name, &supply.cargo.values[r]);
 		}
-
-		return e;
+		supply.interval = maximum(supply.interval, TIMER_TICK);
+		return 0;
 	}
 
-	void destroy(EntityRef e) {
-		while (EntityPtr c = m_world.getFirstChild(e)) {
-			destroy(*c);
+	// Monte-Carlo distribution of expedition outcomes, trial `i` always uses the same random stream
+	ExpeditionForecast forecastExpedition(u32 crew_count, float duration, u32 trials, u64 seed) {
+		PROFILE_FUNCTION();
+		ExpeditionForecast res;
+		if (trials == 0) return res;
+
+		const u32 legs = u32(duration / Expedition::LEG_DURATION);
+		Array<ExpeditionOutcome> outcomes(m_allocator);
+		outcomes.resize(trials);
+		jobs::forEach(trials, 256, [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) {
+				outcomes[i] = {};
+				const u64 key = randomAt(seed, i);
+				for (u32 leg = 0; leg < legs; ++leg) {
+					Expedition::simulateLeg(key, leg, crew_count, outcomes[i]);
+				}
+			}
+		});
+
+		Array<float> materials(m_allocator);
+		materials.resize(trials);
+		double materials_sum = 0;
+		double fuel_sum = 0;
+		u32 recruited = 0;
+		u32 hazards = 0;
+		for (u32 i = 0; i < trials; ++i) {
+			const ExpeditionOutcome& o = outcomes[i];
+			materials[i] = o.materials;
+			materials_sum += o.materials;
+			fuel_sum += o.fuel;
+			if (o.recruits > 0) ++recruited;
+			if (o.hazards > 0) ++hazards;
 		}
-		m_world.destroyEntity(e);
+		qsort(materials.begin(), trials, sizeof(float), [](const void* a, const void* b){
+			const float fa = *(const float*)a;
+			const float fb = *(const float*)b;
+			return fa < fb ? -1 : (fa > fb ? 1 : 0);
+		});
+
+		res.trials = trials;
+		res.materials_mean = float(materials_sum / trials);
+		res.materials_p10 = materials[trials / 10];
+		res.materials_p50 = materials[trials / 2];
+		res.materials_p90 = materials[trials * 9 / 10];
+		res.fuel_mean = float(fuel_sum / trials);
+		res.recruit_chance = recruited / float(trials);
+		res.hazard_chance = hazards / float(trials);
+		return res;
 	}
 
-	void gridLayout(EntityRef root) {
-		GUIModule& gui_scene = getGUIModule();
-		u32 i = 0;
-		for (EntityRef c : m_world.childrenOf(root)) {
-			if (!gui_scene.isRectEnabled(c)) continue;
+	// Game.startExpedition({crew ids}, duration)
+	static int lua_startExpedition(lua_State* L) {
+		LuaWrapper::checkTableArg(L, 1);
+		const float duration = LuaWrapper::checkArg<float>(L, 2);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-			gui_scene.setRectTopRelative(c, 0);
-			gui_scene.setRectTopPoints(c, (i / 2) * 70.f);
-			gui_scene.setRectBottomRelative(c, 0);
-			gui_scene.setRectBottomPoints(c, (i / 2) * 70.f + 64.f);
+		ExpeditionRequest request;
+		request.duration = duration;
+		for (; request.crew_count < Expedition::MAX_CREW; ++request.crew_count) {
+			lua_rawgeti(L, 1, request.crew_count + 1);
+			if (!lua_isnumber(L, -1)) {
+				lua_pop(L, 1);
+				break;
+			}
+			request.crew[request.crew_count] = (u32)lua_tonumber(L, -1);
+			lua_pop(L, 1);
+		}
 
-			gui_scene.setRectLeftRelative(c, (i % 2) * 0.5f);
-			gui_scene.setRectLeftPoints(c, 0);
-			gui_scene.setRectRightRelative(c, (i % 2) * 0.5f + 0.5f);
-			gui_scene.setRectRightPoints(c, 0);
+		game->m_command_queue.push({ GameCommand::START_EXPEDITION, (u32)game->m_expedition_requests.size() });
+		game->m_expedition_requests.push(request);
+		return 0;
+	}
 
-			++i;
+	static int lua_getExpeditions(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		lua_createtable(L, game->m_expeditions.size(), 0); // [expeditions]
+		for (i32 i = 0; i < game->m_expeditions.size(); ++i) {
+			const Expedition& e = game->m_expeditions[i];
+			lua_newtable(L); // [expeditions, expedition]
+			LuaWrapper::setField(L, -1, "id", e.id);
+			LuaWrapper::setField(L, -1, "elapsed", e.elapsed);
+			LuaWrapper::setField(L, -1, "duration", e.duration);
+			LuaWrapper::setField(L, -1, "materials", e.outcome.materials);
+			LuaWrapper::setField(L, -1, "fuel", e.outcome.fuel);
+			LuaWrapper::setField(L, -1, "recruits", e.outcome.recruits);
+			lua_createtable(L, e.crew_count, 0); // [expeditions, expedition, crew]
+			for (u32 j = 0; j < e.crew_count; ++j) {
+				LuaWrapper::push(L, e.crew[j]);
+				lua_rawseti(L, -2, j + 1);
+			}
+			lua_setfield(L, -2, "crew"); // [expeditions, expedition]
+			lua_rawseti(L, -2, i + 1); // [expeditions]
 		}
+		return 1;
 	}
 
-	void selectModule(Module& m) {
-		m_selected_module = &m;
-		const EntityRef module_ui = *getEntity("gui", "moduleui");
-		GUIModule& gui_scene = getGUIModule();
-		gui_scene.enableRect(module_ui, true);
+	// Game.forecastExpedition(crew_count, duration, trials [, seed])
+	static int lua_forecastExpedition(lua_State* L) {
+		const u32 crew_count = LuaWrapper::checkArg<u32>(L, 1);
+		const float duration = LuaWrapper::checkArg<float>(L, 2);
+		const u32 trials = LuaWrapper::checkArg<u32>(L, 3);
+		u32 seed = 0;
+		if (lua_gettop(L) > 3) seed = LuaWrapper::checkArg<u32>(L, 4);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		if (m.build_progress < 1) {
-			const EntityRef templ = findByName(module_ui, "crew", "template");
-			while (EntityPtr s = m_world.getNextSibling(templ)) {
-				destroy(*s);
-			}
+		os::Timer timer;
+		const ExpeditionForecast f = game->forecastExpedition(crew_count, duration, trials, seed);
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "trials", f.trials);
+		LuaWrapper::setField(L, -1, "materials_mean", f.materials_mean);
+		LuaWrapper::setField(L, -1, "materials_p10", f.materials_p10);
+		LuaWrapper::setField(L, -1, "materials_p50", f.materials_p50);
+		LuaWrapper::setField(L, -1, "materials_p90", f.materials_p90);
+		LuaWrapper::setField(L, -1, "fuel_mean", f.fuel_mean);
+		LuaWrapper::setField(L, -1, "recruit_chance", f.recruit_chance);
+		LuaWrapper::setField(L, -1, "hazard_chance", f.hazard_chance);
+		LuaWrapper::setField(L, -1, "time_ms", timer.getTimeSinceStart() * 1000);
+		return 1;
+	}
 
-			for (CrewMember& c : m_station.crew) {
-				const EntityRef e = duplicate(templ);
-				const EntityRef name = findByName(e, "name");
-				gui_scene.setText(name, c.name);
-				gui_scene.enableRect(e, true);
-				setButtonCallback(findByName(e, "assign_button"), [&c, &m](){
-					c.state = CrewMember::State::BUILDING;
-					c.subject = m.id;
-				});
-			}
+	void updateReplication() {
+		if (!m_replication_transport) return;
 
-			gui_scene.enableRect(templ, false);
-			gridLayout(*m_world.getParent(templ));
+		const OutputMemoryStream& message = m_replication_encoder.encode(m_station);
+		if (!m_replication_transport->send(message)) {
+			logError("Replication failed, stopping it");
+			m_replication_transport.reset();
+			return;
 		}
+		m_replication_stats.last_bytes = (u32)message.size();
+		m_replication_stats.total_bytes += message.size();
+		++m_replication_stats.messages;
 	}
 
-	void selectModule(EntityRef e) {
-		for (Module* m : m_station.modules) {
-			if (m->entity == e) {
-				selectModule(*m);
-				return;
-			}
+	// Game.startReplication([path]), without a path the stream goes to an in-process mirror
+	static int lua_startReplication(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-			for (const Extension* ext : m->extensions) {
-				if (ext->entity == e) {
-					selectModule(*m);
-					return;
-				}
+		game->m_replication_encoder.reset();
+		game->m_replication_stats = {};
+
+		if (lua_gettop(L) > 0) {
+			const char* path = LuaWrapper::checkArg<const char*>(L, 1);
+			UniquePtr<FileTransport> transport = UniquePtr<FileTransport>::create(game->m_memory.replication);
+			if (!transport->file.open(path)) {
+				logError("Failed to open ", path);
+				return 0;
 			}
+			game->m_replication_transport = transport.move();
+		}
+		else {
+			game->m_replication_transport = UniquePtr<LoopbackTransport>::create(game->m_memory.replication, game->m_memory.replication);
 		}
+		return 0;
 	}
-	
-	Transform getNeighbourTransform(EntityRef hatch_a, EntityRef hatch_b, EntityRef module_b) const {
-		 Transform hatch_a_tr = m_world.getTransform(hatch_a);
-		const Transform hatch_b_tr = m_world.getTransform(hatch_b);
-		const Transform module_b_tr = m_world.getTransform(module_b);
 
-		hatch_a_tr.rot = hatch_a_tr.rot * Quat(Vec3(0, 1, 0), PI);
+	static int lua_stopReplication(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		const Transform rel = hatch_b_tr.inverted() * module_b_tr;
-		Transform res = hatch_a_tr * rel;
-		res.rot = normalize(res.rot);
-		return res;
+		game->m_replication_transport.reset();
+		return 0;
 	}
 
-	Transform getPinnedTransform(EntityRef hatch_a, EntityRef hatch_b, EntityRef module_b) const {
-		 Transform hatch_a_tr = m_world.getTransform(hatch_a);
-		const Transform hatch_b_tr = m_world.getTransform(hatch_b);
-		const Transform module_b_tr = m_world.getTransform(module_b);
+	static int lua_getReplicationStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		const Transform rel = hatch_b_tr.inverted() * module_b_tr;
-		Transform res = hatch_a_tr * rel;
-		res.rot = normalize(res.rot);
-		return res;
+		const ReplicationStats& s = game->m_replication_stats;
+		lua_newtable(L);
+		LuaWrapper::setField(L, -1, "active", (bool)game->m_replication_transport);
+		LuaWrapper::setField(L, -1, "messages", s.messages);
+		LuaWrapper::setField(L, -1, "last_bytes", s.last_bytes);
+		LuaWrapper::setField(L, -1, "total_bytes", double(s.total_bytes));
+		return 1;
 	}
 
-	void onMouseButton(bool down, int x, int y) {
-		PROFILE_FUNCTION();
-		const Viewport& vp = getRenderModule().getCameraViewport(m_camera);
-		DVec3 origin;
-		Vec3 dir;
-		vp.getRay(Vec2((float)x, (float)y), origin, dir);
-		const Transform ref_tr = m_world.getTransform(m_ref_point);
-		const Vec3 N = ref_tr.rot.rotate(Vec3(0, 0, 1));
-
-		if (m_build_preview.isValid()) {
-			float t;
-			if (getRayPlaneIntersecion(Vec3(origin), dir, Vec3(ref_tr.pos), N, t)) {
-				const DVec3 p = origin + dir * t;
-				if (m_build_ext_type == Extension::Type::EXT) {
-					const Pin pin = getClosestPin(p, 5, "ext_");
-					if (pin.module) {
-						//Extension* ext = addExtension(*pin.module, m_build_ext_type, pin.pin);
-						//const Transform tr = getPinnedTransform((EntityRef)pin.pin, (EntityRef)m_build_preview, (EntityRef)ext->entity);
-						//m_world.setTransform((EntityRef)ext->entity, tr);
-					}
-				}
-				else {
-					const Pin pin = getClosestPin(p, 5, "hatch_");
-					if (pin.module) {
-						Module* m = addModule(*m_build_prefab);
-						const EntityRef hatch_b = (EntityRef)m_world.findByName(m->entity, "hatch_0");
-						const Transform tr = getNeighbourTransform((EntityRef)pin.pin, hatch_b, m->entity);
-						m_world.setTransform(m->entity, tr);
-					}
-				}
-			}
-			destroyChildren((EntityRef)m_build_preview);
-			m_world.destroyEntity((EntityRef)m_build_preview);
-			m_build_preview = INVALID_ENTITY;
-		}
+	// Game.getMemoryStats() -> { [subsystem] = { live, peak, budget, allocations, allocation_rate } }, sizes in bytes
+	static int lua_getMemoryStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		const RayCastModelHit hit = getRenderModule().castRay(origin, dir, INVALID_ENTITY);
-		if (hit.is_hit) {
-			selectModule((EntityRef)hit.entity);
+		lua_newtable(L); // [stats]
+		for (const TrackingAllocator* a : game->m_memory.all) {
+			lua_newtable(L); // [stats, subsystem]
+			LuaWrapper::setField(L, -1, "live", double(a->live));
+			LuaWrapper::setField(L, -1, "peak", double(a->peak));
+			LuaWrapper::setField(L, -1, "budget", double(a->budget));
+			LuaWrapper::setField(L, -1, "allocations", double(a->allocations));
+			LuaWrapper::setField(L, -1, "allocation_rate", a->allocation_rate);
+			lua_setfield(L, -2, a->name); // [stats]
 		}
-	}
-	
-	GUIModule& getGUIModule() {
-		return *(GUIModule*)m_world.getModule(GUI_BUTTON_TYPE);
+		return 1;
 	}
 
-	RenderModule& getRenderModule() {
-		return *(RenderModule*)m_world.getModule(MODEL_INSTANCE_TYPE);
-	}
+	// Game.setMemoryBudget(subsystem, bytes), 0 removes the budget
+	static int lua_setMemoryBudget(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-	LuaScriptModule& getLuaScene() {
-		return *(LuaScriptModule*)m_world.getModule(LUA_SCRIPT_TYPE);
+		const char* name = LuaWrapper::checkArg<const char*>(L, 1);
+		const double budget = LuaWrapper::checkArg<double>(L, 2);
+		TrackingAllocator* a = game->m_memory.find(name);
+		if (!a) return luaL_argerror(L, 1, "unknown subsystem");
+		a->budget = size_t(budget);
+		return 0;
 	}
 
-	Module* addModule(PrefabResource& prefab) {
-		Module* m = LUMIX_NEW(m_allocator, Module)(m_allocator);
-		m->id = ++m_id_generator;
-		EntityMap entity_map(m_allocator);
-		const bool created = m_game.m_engine.instantiatePrefab(m_world, prefab, {0, 0, 0}, Quat::IDENTITY, Vec3(1.f), entity_map);
-		m->entity = (EntityRef)entity_map.m_map[0];
-		m_world.setParent(m_ref_point, m->entity);
-		m_world.setLocalPosition(m->entity, {0, 0, 0});
-		m_station.modules.push(m);
-		return m;
+	// Game.scheduleUpdate(entity, name, function(time_delta) [, { frames = N | ms = T, budget_us = B }])
+	// runs the function every N frames or every T ms (every frame by default) until the entity is destroyed,
+	// time_delta is the time since the previous call; scheduling the same entity and name again replaces the function
+	static int lua_scheduleUpdate(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
+
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 1);
+		const char* name = LuaWrapper::checkArg<const char*>(L, 2);
+		if (!lua_isfunction(L, 3)) return luaL_argerror(L, 3, "function expected");
+		u32 frames = 1;
+		float ms = 0;
+		float budget_us = ScriptScheduler::DEFAULT_BUDGET_US;
+		if (lua_istable(L, 4)) {
+			if (LuaWrapper::getOptionalField(L, 4, "ms", &ms)) frames = 0;
+			LuaWrapper::getOptionalField(L, 4, "frames", &frames);
+			LuaWrapper::getOptionalField(L, 4, "budget_us", &budget_us);
+		}
+		if (frames == 0 && ms <= 0) return luaL_argerror(L, 4, "invalid update rate");
+
+		lua_pushvalue(L, 3);
+		const int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		game->m_scripts.schedule(entity, name, ref, frames, ms, budget_us);
+		return 0;
 	}
 
-	Extension* addExtension(Module& module, const char* blueprint, EntityPtr pin_e) {
-		const BlueprintHandle bp = m_blueprints.find([blueprint](const Blueprint& bp){ return equalStrings(bp.type, blueprint); });
-		ASSERT(bp != -1);
+	// Game.unscheduleUpdates(entity)
+	static int lua_unscheduleUpdates(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		Extension* ext = LUMIX_NEW(m_allocator, Extension);
-		ext->id = ++m_id_generator;
+		const EntityRef entity = LuaWrapper::checkArg<EntityRef>(L, 1);
+		game->m_scripts.remove(entity);
+		return 0;
+	}
 
-		if (m_blueprints[bp].prefab) {
-			EntityMap entity_map(m_allocator);
-			bool res = m_game.m_engine.instantiatePrefab(m_world, *m_blueprints[bp].prefab, {0, 0, 0}, Quat::IDENTITY, Vec3(1.f), entity_map);
-			ASSERT(res);
-			const EntityRef e = (EntityRef)entity_map.m_map[0];
-			ext->entity = e;
-			m_world.setParent(pin_e, e);
-			m_world.setLocalTransform(e, Transform::IDENTITY);
-		}
+	// Game.getScriptStats() -> { frame_us, deferred, scripts = { { name, entity, calls, avg_us, max_us, over_budget, throttle }, ... } }
+	static int lua_getScriptStats(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		ext->blueprint = bp;
-		module.extensions.push(ext);
-		return ext;
+		const ScriptScheduler& scheduler = game->m_scripts;
+		lua_newtable(L); // [stats]
+		LuaWrapper::setField(L, -1, "frame_us", scheduler.getFrameTime());
+		LuaWrapper::setField(L, -1, "deferred", scheduler.getDeferred());
+		lua_newtable(L); // [stats, scripts]
+		i32 i = 0;
+		for (const ScriptScheduler::Script& s : scheduler.getScripts()) {
+			if (s.ref == LUA_NOREF) continue;
+			lua_newtable(L); // [stats, scripts, script]
+			LuaWrapper::setField(L, -1, "name", (const char*)s.name);
+			LuaWrapper::setField(L, -1, "entity", s.entity);
+			LuaWrapper::setField(L, -1, "calls", double(s.calls));
+			LuaWrapper::setField(L, -1, "avg_us", s.avg_us);
+			LuaWrapper::setField(L, -1, "max_us", s.max_us);
+			LuaWrapper::setField(L, -1, "over_budget", s.over_budget);
+			LuaWrapper::setField(L, -1, "throttle", s.throttle);
+			lua_rawseti(L, -2, ++i); // [stats, scripts]
+		}
+		lua_setfield(L, -2, "scripts"); // [stats]
+		return 1;
 	}
 
-	void computeStats(float time_delta) {
-		Stats& stats = m_station.stats;
-		stats.volume = 0;
-		stats.production = {};
-		stats.consumption = {};
-		stats.storage_space = {};
-		stats.storage_space.materials = 15000;
+	// Game.setScriptFrameBudget(us), due scripts past this are deferred to the next frame
+	static int lua_setScriptFrameBudget(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		for (const Module* m : m_station.modules) {
-			if (m->build_progress < 1) continue;
-			stats.consumption.power += 7; // consumed by necessary module electronics
-			for (Extension* ext : m->extensions) {
-				if (ext->build_progress < 1) continue;
+		game->m_scripts.setFrameBudget(LuaWrapper::checkArg<float>(L, 1));
+		return 0;
+	}
 
-				const Blueprint& bp = m_blueprints[ext->blueprint];
-				stats.production.power += bp.power_prod;
-				stats.consumption.power += bp.power_cons;
-			}
-		}
+	// idle crew members do research
+	void updateResearch(float time_delta) {
+		if (m_active_research == ResearchProject::NONE) return;
 
-		const float efficiency = clamp(stats.production.power / stats.consumption.power, 0.f, 1.f);
-		stats.efficiency = efficiency;
+		ResearchProject& project = m_research[m_active_research];
+		if (!advanceProgress(project.progress, time_delta * m_time_multiplier * m_idle_crew, project.time)) return;
 
-		for (const Module* m : m_station.modules) {
-			if (m->build_progress < 1) continue;
-			stats.volume += 40; // usable volume in m3
-			stats.consumption.heat += 10; // IR emission from the module itself
-			stats.production.heat += 5 * efficiency; // produced by necessary module electronics
-			stats.storage_space.food += 500000;
-			stats.storage_space.water += 200;
-			stats.storage_space.fuel += 1000;
-			stats.storage_space.materials += 1000;
-			stats.consumption.fuel += 0.1f;
+		project.progress = 1;
+		project.done = true;
+		m_active_research = ResearchProject::NONE;
+		for (u32 i = 0; i < project.modifiers_count; ++i) {
+			m_active_modifiers.push(project.modifiers[i]);
+		}
+		applyResearch();
+		logInfo("Research finished: ", project.label);
+	}
 
-			for (Extension* ext : m->extensions) {
-				if (ext->build_progress < 1) continue;
-				const Blueprint& bp = m_blueprints[ext->blueprint];
-				
-				stats.production.air += bp.air_prod * efficiency;
-				stats.production.food += bp.food_prod * efficiency;
-				stats.production.heat += bp.heat_prod * efficiency;
-				stats.production.water += bp.water_prod * efficiency;
+	static int lua_getResearch(lua_State* L) {
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-				stats.consumption.air += bp.air_cons * efficiency;
-				stats.consumption.food += bp.food_cons* efficiency;
-				stats.consumption.heat += bp.heat_cons* efficiency;
-				stats.consumption.water += bp.water_cons* efficiency;
-			}
+		lua_createtable(L, game->m_research.size(), 0); // [research]
+		for (i32 i = 0; i < game->m_research.size(); ++i) {
+			const ResearchProject& p = game->m_research[i];
+			lua_newtable(L); // [research, project]
+			LuaWrapper::setField(L, -1, "id", p.id);
+			LuaWrapper::setField(L, -1, "label", p.label);
+			LuaWrapper::setField(L, -1, "time", p.time);
+			LuaWrapper::setField(L, -1, "progress", p.progress);
+			LuaWrapper::setField(L, -1, "done", p.done);
+			LuaWrapper::setField(L, -1, "active", game->m_active_research == (u32)i);
+			const bool available = p.prerequisite == ResearchProject::NONE || game->m_research[p.prerequisite].done;
+			LuaWrapper::setField(L, -1, "available", available);
+			lua_rawseti(L, -2, i + 1); // [research]
 		}
+		return 1;
+	}
 
-		for (CrewMember& c : m_station.crew) {
-			stats.production.heat += 100;
-			stats.consumption.air += 450; 
-			stats.consumption.water += 4.5;
-			stats.consumption.food += 2700;
+	// runs `count` random route queries on the current station, fields are built without the per-tick budget
+	double benchmarkPathfinding(u32 count) {
+		StationGraph& graph = m_station.graph;
+		const u32 nodes_count = graph.m_nodes.size();
+		if (nodes_count == 0) return 0;
+
+		const u32 budget = graph.m_build_budget;
+		graph.m_build_budget = 0xffFFffFF;
+		graph.beginTick();
+
+		Rng rng(count);
+		os::Timer timer;
+		for (u32 i = 0; i < count; ++i) {
+			const u32 from = rng.next(nodes_count);
+			const u32 to = rng.next(nodes_count);
+			graph.getNextHop(from, to);
 		}
+		const float time = timer.getTimeSinceStart();
+		graph.m_build_budget = budget;
+
+		return time > 0 ? count / time : 0;
+	}
 
+	static int lua_benchmarkPathfinding(lua_State* L) {
+		const u32 count = LuaWrapper::checkArg<u32>(L, 1);
+		GameModule* game = getClosureScene(L);
+		if (!game) return 0;
 
-		stats.stored.fuel -= time_delta * stats.consumption.fuel;
-		stats.stored.food += time_delta * (stats.production.food - stats.consumption.food);
-		stats.stored.water += time_delta * (stats.production.water - stats.consumption.water);
-		stats.stored.food = clamp(stats.stored.food, 0.f, stats.storage_space.food);
-		stats.stored.water = clamp(0.f, stats.stored.water, stats.storage_space.water);
-		stats.stored.fuel = clamp(0.f, stats.stored.fuel, stats.storage_space.fuel);
-		stats.stored.materials = clamp(0.f, stats.stored.materials, stats.storage_space.materials);
+		const double qps = game->benchmarkPathfinding(count);
+		logInfo("Pathfinding: ", count, " queries on ", game->m_station.modules.size(), " modules, ", u64(qps), " queries/s");
+		lua_pushnumber(L, qps);
+		return 1;
 	}
 
 	Module* getModule(EntityRef e) {
@@ -1101,10 +5873,40 @@ It produces 20 000 kcal/day of food.)#");
 		blob.write(m_hud);
 		blob.write(m_station.stats);
 		blob.writeArray(m_station.crew);
+		m_station.needs.serialize(blob);
+		m_station.thermal.serialize(blob);
 		blob.write(m_station.modules.size());
 		for (Module* m : m_station.modules) {
 			m->serialize(blob);
 		}
+		blob.writeArray(m_station.graph.m_nodes);
+		m_station.history.serialize(blob);
+		blob.writeArray(m_streaming.queue);
+		blob.write(m_streaming.full_modules);
+		blob.write(m_streaming.entities);
+		blob.write(m_active_research);
+		blob.write(m_research.size());
+		for (const ResearchProject& p : m_research) {
+			blob.write(p.progress);
+			blob.write(p.done);
+		}
+		blob.writeArray(m_active_modifiers);
+		blob.writeArray(m_expeditions);
+		blob.write(m_game_time);
+		blob.write(m_supply);
+		m_supply_wheel.serialize(blob);
+		blob.write((u32)m_supply_ships.size());
+		for (const SupplyShip& ship : m_supply_ships) blob.write(ship);
+		m_failures.serialize(blob);
+		blob.writeArray(m_maintenance);
+		blob.write(m_deterministic);
+		blob.write(m_fixed_stored);
+		blob.write(m_orbit_frame);
+		m_autosave.stop();
+		blob.write(m_autosave_settings);
+		blob.writeArray(m_history.actions);
+		blob.write(m_history.done);
+		blob.write(m_history.budget);
 		
 		GUIModule* gui_scene = (GUIModule*)m_world.getModule(GUI_BUTTON_TYPE);
 		gui_scene->mousedButtonUnhandled().unbind<&GameModule::onMouseButton>(this);
@@ -1119,12 +5921,53 @@ It produces 20 000 kcal/day of food.)#");
 		blob.read(m_hud);
 		blob.read(m_station.stats);
 		blob.readArray(&m_station.crew);
+		m_station.needs.deserialize(blob);
+		m_station.needs.resize(m_station.crew.size());
+		m_station.thermal.deserialize(blob);
 		const i32 size = blob.read<i32>();
 		m_station.modules.resize(size);
 		for (Module*& m : m_station.modules) {
-			m = LUMIX_NEW(m_allocator, Module)(m_allocator);
-			m->deserialize(blob, m_allocator);
+			m = LUMIX_NEW(m_memory.station, Module)(m_memory.station);
+			m->deserialize(blob, m_memory.station);
+		}
+		blob.readArray(&m_station.graph.m_nodes);
+		m_station.graph.clearCache();
+		m_station.history.deserialize(blob);
+		blob.readArray(&m_streaming.queue);
+		blob.read(m_streaming.full_modules);
+		blob.read(m_streaming.entities);
+		blob.read(m_active_research);
+		const i32 research_count = blob.read<i32>();
+		for (i32 i = 0; i < research_count; ++i) {
+			ResearchProject tmp;
+			ResearchProject& p = i < m_research.size() ? m_research[i] : tmp;
+			blob.read(p.progress);
+			blob.read(p.done);
 		}
+		if (m_active_research >= (u32)m_research.size()) m_active_research = ResearchProject::NONE;
+		blob.readArray(&m_active_modifiers);
+		blob.readArray(&m_expeditions);
+		blob.read(m_game_time);
+		blob.read(m_supply);
+		m_supply_wheel.deserialize(blob);
+		const u32 ships_count = blob.read<u32>();
+		m_supply_ships.clear();
+		for (u32 i = 0; i < ships_count; ++i) {
+			const SupplyShip ship = blob.read<SupplyShip>();
+			m_supply_ships.insert(ship.id, ship);
+		}
+		m_failures.deserialize(blob);
+		blob.readArray(&m_maintenance);
+		blob.read(m_deterministic);
+		blob.read(m_fixed_stored);
+		blob.read(m_orbit_frame);
+		blob.read(m_autosave_settings);
+		blob.readArray(&m_history.actions);
+		blob.read(m_history.done);
+		blob.read(m_history.budget);
+		if (m_is_game_started) m_autosave.start();
+		applyResearch();
+		m_solar_dirty = true;
 		
 		initGUI();
 	}
@@ -1138,11 +5981,28 @@ It produces 20 000 kcal/day of food.)#");
 	}
 
 	void updateHUD() {
-		setText(m_hud, "air", "%d l/h", u32(m_station.stats.production.air + m_station.stats.consumption.air));
-		setText(m_hud, "water", "%d l/day", u32(m_station.stats.production.water + m_station.stats.consumption.water));
-		setText(m_hud, "food", "%d kcal/day", u32(m_station.stats.production.food + m_station.stats.consumption.food));
-		setText(m_hud, "power", "%d kW", u32(m_station.stats.production.power + m_station.stats.consumption.power));
-		setText(m_hud, "heat", "%d kJ/s", u32(m_station.stats.production.heat + m_station.stats.consumption.heat));
+		const Stats& stats = m_station.stats;
+		for (u32 r = 0; r < RESOURCE_COUNT; ++r) {
+			if (!RESOURCES[r].hud_format) continue;
+			setText(m_hud, RESOURCES[r].name, RESOURCES[r].hud_format, u32(stats.production.values[r] + stats.consumption.values[r]));
+		}
+	}
+
+	void simulate(float time_delta) {
+		PROFILE_FUNCTION();
+		m_game_time += time_delta * m_time_multiplier;
+		flushCommands();
+		updateCrew(time_delta);
+		updateNeeds(time_delta);
+		updateResearch(time_delta);
+		updateSolar(time_delta);
+		updateExpeditions(time_delta);
+		updateSupply();
+		updateMaintenance();
+		computeStats(time_delta * m_time_multiplier);
+		updateThermal(time_delta);
+		m_station.history.sample(m_station.stats, time_delta * m_time_multiplier);
+		updateReplication();
 	}
 
 	void update(float time_delta) override {
@@ -1151,68 +6011,341 @@ It produces 20 000 kcal/day of food.)#");
 		// searching for resource & crew
 		// crew
 		// research
+		m_memory.update(time_delta);
+		const u64 frame_start = os::Timer::getRawTimestamp();
+		// UI scripts run in menus too, like the lua_script updates they replaced
+		m_scripts.update(time_delta);
 		if (!m_is_game_started) return;
 
 		m_angle = fmodf(m_angle + m_time_multiplier * time_delta * 0.2f, PI * 2);
-		const float R = 6378e3 + 400e3;
-		const DVec3 ref_point_pos = {cosf(m_angle) * R, 0, sinf(m_angle) * R};
-		m_world.setPosition(m_ref_point, ref_point_pos);
-		m_world.setRotation(m_ref_point, Quat({0, 1, 0}, -m_angle + PI * 0.5f));
+		updateOrbit();
 
 		updateCamera(time_delta);
 		updateHUD();
+		simulate(time_delta);
+		updateAutosave(time_delta);
+		updateStreaming();
+		updateBuildPreview();
+		m_frame_times.add(frame_start, m_autosave.isBusy());
+	}
 
-		for (CrewMember& c : m_station.crew) {
-			if (c.state == CrewMember::BUILDING) {
-				for (Module* m : m_station.modules) {
-					if (m->id == c.subject) {
-						m->build_progress += time_delta * 0.01f * m_time_multiplier;
-						if (m->build_progress >= 1) {
-							m->build_progress  = 1;
-							c.state = CrewMember::IDLE;
-						}
-						break;
-					}
-					for (Extension* ext : m->extensions) {
-						if (ext->id == c.subject) {
-							ext->build_progress += time_delta * 0.05f * m_time_multiplier;
-							if (ext->build_progress >= 1) {
-								ext->build_progress  = 1;
-								c.state = CrewMember::IDLE;
-								c.subject = -1;
-							}
-							break;
-						}
-					}
+	// Everything the simulation needs, entities and GUI are rebuilt from it. Called at a tick boundary.
+	void captureSnapshot(OutputMemoryStream& blob) const {
+		PROFILE_FUNCTION();
+		// summary first, so a save can be inspected without parsing the rest
+		blob.write(m_game_time);
+		blob.write((u32)m_station.modules.size());
+		blob.write((u32)m_station.crew.size());
+
+		// modules next, restoreSnapshot rebuilds their entities before reading anything that refers to them
+		blob.write(m_station.modules.size());
+		for (const Module* m : m_station.modules) {
+			m->serialize(blob);
+		}
+		blob.write(m_id_generator);
+		blob.write(m_time_multiplier);
+		blob.write(m_angle);
+		blob.write(m_station.stats);
+		blob.writeArray(m_station.crew);
+		m_station.needs.serialize(blob);
+		m_station.thermal.serialize(blob);
+		blob.writeArray(m_station.graph.m_nodes);
+		m_station.history.serialize(blob);
+		// streaming settings, which modules are expanded follows from the viewpoint once the entities are rebuilt
+		blob.write(m_streaming.expand_distance);
+		blob.write(m_streaming.collapse_distance);
+		blob.write(m_streaming.max_full_modules);
+		blob.write(m_streaming.expands_per_frame);
+		blob.write(m_streaming.checks_per_frame);
+		blob.write(m_streaming.has_viewpoint);
+		blob.write(m_streaming.viewpoint);
+		blob.write(m_active_research);
+		blob.write(m_research.size());
+		for (const ResearchProject& p : m_research) {
+			blob.write(p.progress);
+			blob.write(p.done);
+		}
+		blob.writeArray(m_active_modifiers);
+		blob.writeArray(m_expeditions);
+		blob.writeArray(m_expedition_requests);
+		blob.writeArray(m_placement_requests);
+		blob.write(m_expedition_seed);
+		blob.writeArray(m_command_queue);
+		blob.write(m_supply);
+		m_supply_wheel.serialize(blob);
+		blob.write((u32)m_supply_ships.size());
+		for (const SupplyShip& ship : m_supply_ships) blob.write(ship);
+		m_failures.serialize(blob);
+		blob.writeArray(m_maintenance);
+		blob.write(m_deterministic);
+		blob.write(m_fixed_stored);
+	}
+
+	// Replaces the station with a snapshot from captureSnapshot. Modules and extensions are instantiated from
+	// a template built from the snapshot, then get back their ids and state. Fails without touching the station
+	// if the snapshot's modules can not be read, leaves an empty station if they can not be instantiated.
+	bool restoreSnapshot(InputMemoryStream& blob) {
+		PROFILE_FUNCTION();
+		const double game_time = blob.read<double>();
+		blob.read<u32>(); // modules
+		blob.read<u32>(); // crew
+
+		const i32 modules_count = blob.read<i32>();
+		if (blob.hasOverflow() || modules_count < 0) return false;
+		Array<Module*> modules(m_allocator);
+		auto destroyModules = [&](){
+			for (Module* m : modules) {
+				for (Extension* ext : m->extensions) LUMIX_DELETE(m_allocator, ext);
+				LUMIX_DELETE(m_allocator, m);
+			}
+		};
+		StationTemplate tpl(m_allocator);
+		HashMap<u32, u32> indices(m_allocator);
+		for (i32 i = 0; i < modules_count; ++i) {
+			Module* m = LUMIX_NEW(m_allocator, Module)(m_allocator);
+			modules.push(m);
+			m->deserialize(blob, m_allocator);
+			if (blob.hasOverflow()) {
+				destroyModules();
+				return false;
+			}
+			auto parent = indices.find(m->parent_id);
+			const u32 idx = parent.isValid()
+				? tpl.addModule(m->type, parent.value(), m->parent_hatch, m->hatch)
+				: tpl.addModule(m->type);
+			tpl.modules[idx].build_progress = m->build_progress;
+			indices.insert(m->id, idx);
+			for (const Extension* ext : m->extensions) {
+				if (ext->blueprint >= (u32)m_blueprints.size()) {
+					logError("Unknown extension blueprint ", ext->blueprint, " in snapshot");
+					destroyModules();
+					return false;
 				}
+				tpl.addExtension(idx, m_blueprints[ext->blueprint].type, ext->pin, ext->build_progress);
 			}
 		}
+		if (modules_count == 0) clearStation();
+		else if (!instantiateTemplate(tpl)) {
+			destroyModules();
+			return false;
+		}
 
-		computeStats(time_delta * m_time_multiplier);
-		updateBuildPreview();
+		// the template keeps the order of modules and of their extensions, only the entities are new
+		for (i32 i = 0; i < modules_count; ++i) {
+			Module& dst = *m_station.modules[i];
+			const Module& src = *modules[i];
+			dst.id = src.id;
+			dst.parent_id = src.parent_id;
+			for (i32 j = 0; j < dst.extensions.size(); ++j) {
+				Extension& ext = *dst.extensions[j];
+				const EntityPtr entity = ext.entity;
+				ext = *src.extensions[j];
+				ext.entity = entity;
+			}
+		}
+		destroyModules();
+
+		m_game_time = game_time;
+		blob.read(m_id_generator);
+		blob.read(m_time_multiplier);
+		blob.read(m_angle);
+		blob.read(m_station.stats);
+		blob.readArray(&m_station.crew);
+		m_station.needs.deserialize(blob);
+		m_station.needs.resize(m_station.crew.size());
+		m_station.thermal.deserialize(blob);
+		blob.readArray(&m_station.graph.m_nodes);
+		m_station.graph.clearCache();
+		m_station.history.deserialize(blob);
+		blob.read(m_streaming.expand_distance);
+		blob.read(m_streaming.collapse_distance);
+		blob.read(m_streaming.max_full_modules);
+		blob.read(m_streaming.expands_per_frame);
+		blob.read(m_streaming.checks_per_frame);
+		blob.read(m_streaming.has_viewpoint);
+		blob.read(m_streaming.viewpoint);
+		blob.read(m_active_research);
+		const i32 research_count = blob.read<i32>();
+		for (i32 i = 0; i < research_count; ++i) {
+			ResearchProject tmp;
+			ResearchProject& p = i < m_research.size() ? m_research[i] : tmp;
+			blob.read(p.progress);
+			blob.read(p.done);
+		}
+		if (m_active_research >= (u32)m_research.size()) m_active_research = ResearchProject::NONE;
+		blob.readArray(&m_active_modifiers);
+		blob.readArray(&m_expeditions);
+		blob.readArray(&m_expedition_requests);
+		blob.readArray(&m_placement_requests);
+		blob.read(m_expedition_seed);
+		blob.readArray(&m_command_queue);
+		blob.read(m_supply);
+		m_supply_wheel.deserialize(blob);
+		const u32 ships_count = blob.read<u32>();
+		m_supply_ships.clear();
+		for (u32 i = 0; i < ships_count; ++i) {
+			const SupplyShip ship = blob.read<SupplyShip>();
+			m_supply_ships.insert(ship.id, ship);
+		}
+		m_failures.deserialize(blob);
+		blob.readArray(&m_maintenance);
+		blob.read(m_deterministic);
+		blob.read(m_fixed_stored);
+		applyResearch();
+		m_solar_dirty = true;
+		m_replication_encoder.reset();
+		if (blob.hasOverflow()) {
+			logError("Truncated snapshot");
+			return false;
+		}
+		return true;
+	}
+
+	// puts back a station kept by captureSnapshot while a generated one replaced it
+	void restoreStation(const OutputMemoryStream& station) {
+		InputMemoryStream blob(station);
+		if (!restoreSnapshot(blob)) logError("Failed to restore the station");
+	}
+
+	StaticString<MAX_PATH> getSavePath(const char* path) const {
+		return StaticString<MAX_PATH>(m_game.m_engine.getFileSystem().getBasePath(), path);
+	}
+
+	bool loadAutosave(const char* path) {
+		OutputMemoryStream snapshot(m_allocator);
+		if (!Autosave::read(getSavePath(path), snapshot, m_allocator)) {
+			logError("Failed to read save ", path);
+			return false;
+		}
+		InputMemoryStream blob(snapshot);
+		if (!restoreSnapshot(blob)) {
+			logError("Failed to load save ", path);
+			return false;
+		}
+		return true;
+	}
+
+	// false if the previous save is still being written
+	bool requestAutosave(const char* path) {
+		OutputMemoryStream* blob = m_autosave.beginCapture();
+		if (!blob) return false;
+		const u64 t = os::Timer::getRawTimestamp();
+		captureSnapshot(*blob);
+		m_autosave.commit(path);
+
+		AutosaveSettings& a = m_autosave_settings;
+		a.capture_us = float((os::Timer::getRawTimestamp() - t) * 1e6 / os::Timer::getFrequency());
+		a.max_capture_us = maximum(a.max_capture_us, a.capture_us);
+		++a.saves;
+		return true;
+	}
+
+	void updateAutosave(float time_delta) {
+		AutosaveSettings& a = m_autosave_settings;
+		if (a.interval <= 0) return;
+		a.since += time_delta;
+		if (a.since < a.interval) return;
+		// a slow disk delays the next save instead of stalling the game
+		if (!requestAutosave(getSavePath(a.path))) {
+			++a.skipped;
+			return;
+		}
+		a.since = 0;
+	}
+
+	// Where the station would be in the world if it was the one orbiting.
+	Transform getOrbitTransform() const {
+		const float R = 6378e3 + 400e3;
+		const DVec3 pos = {cosf(m_angle) * R, 0, sinf(m_angle) * R};
+		return Transform(pos, Quat({0, 1, 0}, -m_angle + PI * 0.5f), Vec3(1));
+	}
+
+	void initOrbitFrame() {
+		m_orbit_frame.count = 0;
+		const char* names[] = { "earth", "environment" };
+		for (const char* name : names) {
+			const EntityPtr e = m_world.findByName(INVALID_ENTITY, name);
+			if (!e.isValid()) continue;
+			OrbitFrame::Body& body = m_orbit_frame.bodies[m_orbit_frame.count];
+			body.entity = (EntityRef)e;
+			body.original = m_world.getTransform(body.entity);
+			++m_orbit_frame.count;
+		}
+		m_orbit_frame.ref_point_placed = false;
+	}
+
+	// In the station frame the station hierarchy never moves; the few bodies outside of it are moved by the inverse
+	// of the orbit instead. This keeps the whole station near the origin in float precision, and the transform
+	// system does not have to propagate the orbit to every module, extension and the camera each frame.
+	void updateOrbit() {
+		PROFILE_FUNCTION();
+		const Transform orbit = getOrbitTransform();
+		OrbitFrame& frame = m_orbit_frame;
+		if (!frame.station_frame) {
+			m_world.setTransform(m_ref_point, orbit);
+			frame.updated = 1 + m_streaming.entities + 1; // ref point, station, camera
+			frame.avoided = 0;
+			return;
+		}
+
+		if (!frame.ref_point_placed) {
+			m_world.setTransform(m_ref_point, Transform::IDENTITY);
+			frame.ref_point_placed = true;
+		}
+		const Transform to_station = orbit.inverted();
+		for (u32 i = 0; i < frame.count; ++i) {
+			const OrbitFrame::Body& body = frame.bodies[i];
+			m_world.setTransform(body.entity, to_station * body.original);
+		}
+		frame.updated = frame.count;
+		frame.avoided = 1 + m_streaming.entities + 1;
+		frame.avoided_total += frame.avoided;
+		profiler::pushInt("Transforms avoided", frame.avoided);
+	}
+
+	void setStationFrame(bool enable) {
+		if (m_orbit_frame.station_frame == enable) return;
+		m_orbit_frame.station_frame = enable;
+		m_orbit_frame.ref_point_placed = false;
+		if (!enable) {
+			for (u32 i = 0; i < m_orbit_frame.count; ++i) {
+				const OrbitFrame::Body& body = m_orbit_frame.bodies[i];
+				m_world.setTransform(body.entity, body.original);
+			}
+		}
+		if (m_is_game_started) updateOrbit();
+		m_solar_dirty = true;
+	}
+
+	const Extension* getExtensionOnPin(const Module& module, const char* pin) const {
+		for (const Extension* ext : module.extensions) {
+			if (equalStrings(ext->pin, pin)) return ext;
+		}
+		return nullptr;
 	}
 
 	struct Pin {
-		Module* module;
-		EntityPtr pin;
+		Module* module = nullptr;
+		const PrefabPin* pin = nullptr;
 	}; 
 
-	Pin getClosestPin(const DVec3& p, float max_dist, const char* prefix) {
-		EntityPtr closest_pin = INVALID_ENTITY;
+	// pins come from the prefab's metadata, so collapsed modules without child entities have them too
+	Pin getClosestPin(const DVec3& p, float max_dist, PrefabPin::Kind kind) {
+		const PrefabPin* closest_pin = nullptr;
 		Module* closest_module = nullptr;
 		float pin_dist = FLT_MAX;
 		for (Module* m : m_station.modules) {
 			if (m->build_progress < 1) continue;
-			for (EntityPtr ch = m_world.getFirstChild(m->entity); ch.isValid(); ch = m_world.getNextSibling((EntityRef)ch)) {
-				EntityRef child = (EntityRef)ch;
-				const char* name = m_world.getEntityName(child);
-				if (startsWith(name, prefix)) {
-					const double d = squaredLength(p - m_world.getPosition(child));
-					if (d < pin_dist) {
-						pin_dist = (float)d;
-						closest_pin = child;
-						closest_module = m;
-					}
+			const PrefabPins* pins = getModulePins(m->type);
+			if (!pins) continue;
+			const Transform module_tr = m_world.getTransform(m->entity);
+			for (const PrefabPin& pin : *pins) {
+				if (pin.kind != kind) continue;
+				const double d = squaredLength(p - module_tr.transform(DVec3(pin.pos)));
+				if (d < pin_dist) {
+					pin_dist = (float)d;
+					closest_pin = &pin;
+					closest_module = m;
 				}
 			}
 		}
@@ -1239,31 +6372,28 @@ It produces 20 000 kcal/day of food.)#");
 		if (getRayPlaneIntersecion(Vec3(origin), dir, Vec3(ref_tr.pos), N, t)) {
 			const DVec3 p = origin + dir * t;
 			const bool is_ext = m_build_ext_type == Extension::Type::EXT;
-			const Pin pin = getClosestPin(p, 5, is_ext ? "ext_" : "hatch_");
+			const Pin pin = getClosestPin(p, 5, is_ext ? PrefabPin::Kind::EXT : PrefabPin::Kind::HATCH);
 			if (pin.module) {
 				if (is_ext) {
-					const Transform tr = getPinnedTransform((EntityRef)pin.pin, (EntityRef)m_build_preview, (EntityRef)m_build_preview);
-					m_world.setTransform((EntityRef)m_build_preview, tr);
+					m_world.setTransform((EntityRef)m_build_preview, getPinTransform(*pin.module, *pin.pin));
 					return;
 				}
 				
-				const EntityRef hatch_b = (EntityRef)m_world.findByName((EntityRef)m_build_preview, "hatch_0");				
-				const Transform tr = getNeighbourTransform((EntityRef)pin.pin, hatch_b, (EntityRef)m_build_preview);
-				m_world.setTransform((EntityRef)m_build_preview, tr);
-				return;
+				const PrefabPin* hatch_b = getAttachHatch(m_build_module_type);
+				if (hatch_b) {
+					const Transform tr = getNeighbourTransform(getPinTransform(*pin.module, *pin.pin), hatch_b->getLocalTransform());
+					m_world.setTransform((EntityRef)m_build_preview, tr);
+					return;
+				}
 			}
 
 			m_world.setPosition((EntityRef)m_build_preview, p);
 		}
 	}
 
-	struct ButtonCallback {
-		virtual ~ButtonCallback() {}
-		virtual void invoke() = 0;
-	};
-
 	bool m_is_game_started = false;
 	u32 m_time_multiplier = 0;
+	GameMemory m_memory;
 	IAllocator& m_allocator;
 	Game& m_game;
 	World& m_world;
@@ -1272,17 +6402,781 @@ It produces 20 000 kcal/day of food.)#");
 	EntityRef m_hud;
 	EntityRef m_ref_point;
 	float m_angle = 0;
+	struct OrbitFrame {
+		struct Body {
+			EntityRef entity;
+			Transform original;
+		};
+		bool station_frame = true;
+		bool ref_point_placed = false;
+		Body bodies[2];
+		u32 count = 0;
+		u32 updated = 0;
+		u32 avoided = 0;
+		u64 avoided_total = 0;
+	} m_orbit_frame;
 	
 	EntityPtr m_build_preview = INVALID_ENTITY;
-	PrefabResource* m_build_prefab = nullptr;
+	u32 m_build_module_type = 0;
 	Extension::Type m_build_ext_type = Extension::Type::NONE;
+	BlueprintHandle m_build_blueprint = 0; // extension placed by the preview if m_build_ext_type is EXT
 
 	Module* m_selected_module = nullptr;
 	u32 m_id_generator = 0;
-	Array<Blueprint> m_blueprints;
-	HashMap<EntityRef, UniquePtr<ButtonCallback>> m_button_callbacks;
+	Array<Blueprint> m_blueprints; // with research applied
+	Array<Blueprint> m_base_blueprints;
+	BlueprintHandle m_sleeping_quarter;
+	BlueprintHandle m_solar_panel;
+	SolarPanels m_solar;
+	bool m_solar_dirty = true; // built panels changed
+	float m_solar_output = 0;
+	Array<ResearchProject> m_research;
+	Array<ResearchModifier> m_active_modifiers;
+	u32 m_active_research = ResearchProject::NONE;
+	u32 m_idle_crew = 0;
+	Array<Expedition> m_expeditions;
+	double m_game_time = 0; // seconds of simulated time, scaled by m_time_multiplier
+	TimingWheel m_supply_wheel;
+	HashMap<u32, SupplyShip> m_supply_ships;
+	SupplySchedule m_supply;
+	TimingWheel m_failures; // predicted breakdowns, payload is an ExtensionFailure
+	Array<u32> m_maintenance; // broken extensions waiting for a repair
+	ConstructionHistory m_history;
+	Array<ExpeditionRequest> m_expedition_requests;
+	Array<PlacementRequest> m_placement_requests;
+	u64 m_expedition_seed = 0x5EED;
+
+	struct ReplicationStats {
+		u32 messages = 0;
+		u32 last_bytes = 0;
+		u64 total_bytes = 0;
+	};
+	ReplicationEncoder m_replication_encoder;
+	UniquePtr<IReplicationTransport> m_replication_transport;
+	ReplicationStats m_replication_stats;
+
+	// deterministic simulation, see computeStatsFixed
+	bool m_deterministic = false;
+	Fixed m_fixed_stored[RESOURCE_COUNT] = {};
+
+	Autosave m_autosave;
+	struct AutosaveSettings {
+		StaticString<MAX_PATH> path{"autosave.sav"}; // relative to the data directory
+		float interval = 0; // seconds of real time, 0 disables
+		float since = 0;
+		u32 saves = 0;
+		u32 skipped = 0; // the previous save was still being written
+		float capture_us = 0;
+		float max_capture_us = 0;
+	} m_autosave_settings;
+
+	// game update time, split by whether an autosave was being written during the frame
+	struct FrameTimes {
+		void add(u64 start, bool saving) {
+			const float us = float((os::Timer::getRawTimestamp() - start) * 1e6 / os::Timer::getFrequency());
+			max_us[saving] = maximum(max_us[saving], us);
+			sum_us[saving] += us;
+			++frames[saving];
+		}
+
+		float getAvgUS(bool saving) const { return frames[saving] ? float(sum_us[saving] / frames[saving]) : 0.f; }
+
+		float max_us[2] = {};
+		double sum_us[2] = {};
+		u32 frames[2] = {};
+	} m_frame_times;
+	Array<Fixed> m_fixed_blueprints; // Blueprint::FIELD_COUNT columns of m_blueprints.size() values
+	Array<Fixed> m_built_extensions; // per blueprint
+	ButtonCallbacks m_button_callbacks;
+	ScriptScheduler m_scripts;
+	ModuleStreaming m_streaming;
+	HashMap<u32, GameCommand> m_commands;
+	Array<GameCommand> m_command_queue;
+	OutputMemoryStream m_player_station; // snapshot kept while Game.generateStation replaces the station
+};
+
+
+// Generated stations and the benchmark suite. They drive GameModule through its members like a script would.
+// Every subsystem has its own benchmark function, `run` goes through the tables of them.
+
+bool StationBenchmarks::generateStation(GameModule& game, u32 seed, u32 modules_count, u32 crew_count) {
+	PROFILE_FUNCTION();
+	if (!game.areModulePrefabsReady()) {
+		logError("Module prefabs are not loaded yet, can not generate a station");
+		return false;
+	}
+	game.clearStation();
+	Rng rng(seed);
+
+	struct FreeHatch {
+		Module* module;
+		const PrefabPin* hatch;
+	};
+	Array<FreeHatch> free_hatches(game.m_allocator);
+	Array<u32> jobs(game.m_allocator);
+
+	auto addFreeHatches = [&](Module* m, const PrefabPin* used) {
+		for (const PrefabPin& pin : *game.getModulePins(m->type)) {
+			if (pin.kind == PrefabPin::Kind::HATCH && &pin != used) free_hatches.push({m, &pin});
+		}
+	};
+
+	auto addRandomExtensions = [&](Module* m) {
+		const PrefabPin* ext_pin = nullptr;
+		for (const PrefabPin& pin : *game.getModulePins(m->type)) {
+			if (pin.kind == PrefabPin::Kind::EXT) {
+				ext_pin = &pin;
+				break;
+			}
+		}
+		for (u32 i = 0, c = rng.next(4); i < c; ++i) {
+			BlueprintHandle bp = rng.next(game.m_blueprints.size());
+			// extensions with a prefab need a free `ext_` pin
+			while (game.m_blueprints[bp].prefab != Assets::NONE && !ext_pin) bp = rng.next(game.m_blueprints.size());
+			const bool has_prefab = game.m_blueprints[bp].prefab != Assets::NONE;
+			const char* pin = has_prefab ? ext_pin->name.data : "";
+			if (has_prefab) ext_pin = nullptr;
+
+			Extension* ext = game.addExtension(*m, bp, pin);
+			ext->build_progress = rng.nextFloat() < 0.8f ? 1.f : 0.f;
+			if (ext->build_progress < 1) jobs.push(ext->id);
+		}
+	};
+
+	Module* root = game.addModule(2);
+	game.m_world.setRotation(root->entity, Quat::vec3ToVec3(Vec3(0, 1, 0), Vec3(0, 0, 1)));
+	root->build_progress = 1;
+	addFreeHatches(root, nullptr);
+	addRandomExtensions(root);
+
+	SpaceStation& station = game.m_station;
+	for (u32 i = 1; i < modules_count && !free_hatches.empty(); ++i) {
+		const u32 hatch_idx = rng.next(free_hatches.size());
+		const FreeHatch pin = free_hatches[hatch_idx];
+		free_hatches.swapAndPop(hatch_idx);
+
+		Module* m = game.addModule(GameModule::MODULE_TYPES[rng.next(lengthOf(GameModule::MODULE_TYPES))]);
+		const PrefabPin* hatch_b = game.getAttachHatch(m->type);
+		ASSERT(hatch_b);
+		game.m_world.setTransform(m->entity, GameModule::getNeighbourTransform(game.getPinTransform(*pin.module, *pin.hatch), hatch_b->getLocalTransform()));
+		station.graph.connect(station.modules.indexOf(pin.module), station.modules.indexOf(m));
+		m->parent_id = pin.module->id;
+		m->parent_hatch = pin.hatch->name;
+		m->hatch = hatch_b->name;
+		addFreeHatches(m, hatch_b);
+
+		m->build_progress = rng.nextFloat() < 0.9f ? 1.f : 0.f;
+		if (m->build_progress < 1) jobs.push(m->id);
+		addRandomExtensions(m);
+	}
+
+	for (u32 i = 0; i < crew_count; ++i) {
+		CrewMember& c = station.crew.emplace();
+		c.id = ++game.m_id_generator;
+		c.name = StaticString<128>("Crew member ", i + 1);
+		c.module = rng.next(station.modules.size());
+		if (!jobs.empty()) {
+			c.state = CrewMember::BUILDING;
+			c.subject = jobs[rng.next(jobs.size())];
+		}
+	}
+	station.needs.resize(station.crew.size());
+
+	game.updateAllWear();
+	game.initStorage();
+	return true;
+}
+
+void StationBenchmarks::benchmarkTick(Context& ctx) {
+	GameModule& game = ctx.game;
+	ctx.report.measure("tick.crew", 100, [&](){ game.updateCrew(DT); });
+	ctx.report.measure("tick.stats", 100, [&](){ game.computeStats(DT); });
+	ctx.report.measure("tick.history", 100, [&](){ game.m_station.history.sample(game.m_station.stats, DT); });
+	ctx.report.measure("tick.total", 100, [&](){ game.simulate(DT); });
+}
+
+// moving the whole station hierarchy vs. moving only the bodies around it
+void StationBenchmarks::benchmarkOrbit(Context& ctx) {
+	GameModule& game = ctx.game;
+	const bool station_frame = game.m_orbit_frame.station_frame;
+	const float angle = game.m_angle;
+	game.setStationFrame(false);
+	ctx.report.measure("orbit.world_frame", 100, [&](){ game.m_angle += 1e-3f; game.updateOrbit(); });
+	game.setStationFrame(true);
+	ctx.report.measure("orbit.station_frame", 100, [&](){ game.m_angle += 1e-3f; game.updateOrbit(); });
+	ctx.report.value("orbit.transforms_avoided", game.m_orbit_frame.avoided);
+	game.m_angle = angle;
+	game.setStationFrame(station_frame);
+}
+
+// the game thread pays only for the capture, frames with a save in flight must not spike
+void StationBenchmarks::benchmarkAutosave(Context& ctx) {
+	GameModule& game = ctx.game;
+	BenchmarkReport& report = ctx.report;
+	const bool autosave_running = game.m_autosave.isRunning();
+	game.m_autosave.start();
+	OutputMemoryStream snapshot(game.m_allocator);
+	report.measure("autosave.capture", 10, [&](){
+		snapshot.clear();
+		game.captureSnapshot(snapshot);
+	});
+	report.value("autosave.snapshot_bytes", double(snapshot.size()));
+
+	const StaticString<MAX_PATH> save_path(ctx.path, ".sav");
+	GameModule::FrameTimes frames;
+	for (u32 i = 0; i < 100; ++i) {
+		const u64 t = os::Timer::getRawTimestamp();
+		game.simulate(DT);
+		if (i % 25 == 0) game.requestAutosave(save_path);
+		frames.add(t, game.m_autosave.isBusy());
+	}
+	while (game.m_autosave.isBusy()) os::sleep(1);
+	const Autosave::Result& result = game.m_autosave.getResult();
+	report.value("autosave.compressed_bytes", double(result.size));
+	report.value("autosave.compress_ms", result.compress_ms);
+	report.value("autosave.write_ms", result.write_ms);
+	report.value("autosave.frame_avg_us_idle", frames.getAvgUS(false));
+	report.value("autosave.frame_max_us_idle", frames.max_us[0]);
+	report.value("autosave.frame_avg_us_saving", frames.getAvgUS(true));
+	report.value("autosave.frame_max_us_saving", frames.max_us[1]);
+	os::deleteFile(save_path.data);
+	if (!autosave_running) game.m_autosave.stop();
+}
+
+// undo and redo touch only the object an action created, the cost must not grow with the station
+void StationBenchmarks::benchmarkUndo(Context& ctx) {
+	GameModule& game = ctx.game;
+	// the last generated module is a leaf, all its hatches but the one it hangs on are free
+	const u32 parent = game.m_station.modules.size() - 1;
+	const Module& leaf = *game.m_station.modules[parent];
+	const PrefabPin* free_hatch = nullptr;
+	for (const PrefabPin& pin : *game.getModulePins(leaf.type)) {
+		if (pin.kind == PrefabPin::Kind::HATCH && !equalStrings(pin.name, leaf.hatch)) {
+			free_hatch = &pin;
+			break;
+		}
+	}
+	Module* m = free_hatch ? game.attachModule(parent, *free_hatch, 2) : nullptr;
+	if (!m) return;
+
+	game.recordAddModule(*m, parent);
+	game.recordAddExtension(parent + 1, *game.addExtension(*m, game.m_sleeping_quarter, ""));
+	ctx.report.measure("undo.extension", 100, [&](){
+		game.undoConstruction();
+		game.redoConstruction();
+	});
+	game.undoConstruction();
+	ctx.report.measure("undo.module", 100, [&](){
+		game.undoConstruction();
+		game.redoConstruction();
+	});
+	ctx.report.value("undo.history_bytes", double(game.m_history.getBytes()));
+	game.undoConstruction();
+	game.m_history.clear();
+}
+
+void StationBenchmarks::benchmarkExpeditions(Context& ctx) {
+	GameModule& game = ctx.game;
+	ctx.report.measure("expeditions.forecast_10000_trials", 10, [&](){ game.forecastExpedition(2, 3600, 10'000, ctx.seed); });
+	for (u32 i = 0; i < 1000; ++i) {
+		Expedition& e = game.m_expeditions.emplace();
+		e.id = i;
+		e.key = randomAt(ctx.seed, i);
+		e.crew_count = 1;
+		e.duration = 1e9f;
+	}
+	ctx.report.measure("tick.expeditions_1000", 100, [&](){ game.updateExpeditions(60); });
+	game.m_expeditions.clear();
+}
+
+// a week of wear in one step, the cost follows the breakdowns, not the extensions
+void StationBenchmarks::benchmarkMaintenance(Context& ctx) {
+	GameModule& game = ctx.game;
+	ctx.report.measure("tick.maintenance_week", 1, [&](){
+		game.m_game_time += 7 * 24 * 3600;
+		game.updateMaintenance();
+	});
+	ctx.report.value("maintenance.broken_after_week", game.m_maintenance.size());
+}
+
+void StationBenchmarks::benchmarkReplication(Context& ctx) {
+	GameModule& game = ctx.game;
+	ReplicationEncoder encoder(game.m_allocator);
+	ReplicationMirror mirror(game.m_allocator);
+	const double to_us = 1e6 / os::Timer::getFrequency();
+	u64 encode_time = 0;
+	u64 decode_time = 0;
+	u64 delta_bytes = 0;
+	u64 keyframe_bytes = 0;
+	const u32 ticks = ReplicationEncoder::KEYFRAME_INTERVAL;
+	for (u32 i = 0; i < ticks; ++i) {
+		game.simulate(DT);
+		u64 t = os::Timer::getRawTimestamp();
+		const OutputMemoryStream& message = encoder.encode(game.m_station);
+		encode_time += os::Timer::getRawTimestamp() - t;
+		if (i == 0) keyframe_bytes = message.size();
+		else delta_bytes += message.size();
+
+		t = os::Timer::getRawTimestamp();
+		InputMemoryStream blob(message);
+		mirror.apply(blob);
+		decode_time += os::Timer::getRawTimestamp() - t;
+	}
+	ctx.report.value("replication.keyframe_bytes", double(keyframe_bytes));
+	ctx.report.value("replication.delta_bytes_per_tick", delta_bytes / double(ticks - 1));
+	ctx.report.value("replication.encode_us_per_tick", encode_time * to_us / ticks);
+	ctx.report.value("replication.decode_us_per_tick", decode_time * to_us / ticks);
+}
+
+// stats must cost the same with any amount of finished research
+void StationBenchmarks::benchmarkResearch(Context& ctx) {
+	GameModule& game = ctx.game;
+	Rng rng(ctx.seed);
+	for (u32 i = 0; i < 500; ++i) {
+		ResearchModifier& m = game.m_active_modifiers.emplace();
+		m.blueprint = rng.next(game.m_base_blueprints.size());
+		m.field = (Blueprint::Field)rng.next(Blueprint::FIELD_COUNT);
+		m.op = rng.next(2) ? ResearchModifier::ADD : ResearchModifier::MUL;
+		m.value = m.op == ResearchModifier::ADD ? 1.f : 1.001f;
+	}
+	ctx.report.measure("research.apply_500_modifiers", 10, [&](){ game.applyResearch(); });
+	ctx.report.measure("tick.stats_500_modifiers", 100, [&](){ game.computeStats(DT); });
+	game.m_active_modifiers.clear();
+	game.applyResearch();
+}
+
+void StationBenchmarks::benchmarkPathfinding(Context& ctx) {
+	ctx.report.measure("pathfinding.1000_queries", 10, [&](){ ctx.game.benchmarkPathfinding(1000); });
+}
+
+void StationBenchmarks::benchmarkCommands(Context& ctx) {
+	GameModule& game = ctx.game;
+	ctx.report.measure("commands.dispatch", 1000, [&](){
+		game.queueCommand("time_1x");
+		game.flushCommands();
+	});
+}
+
+// the first unfinished module, its GUI has the most to show
+Module& StationBenchmarks::selectBusyModule(GameModule& game) {
+	Module* module = game.m_station.modules[0];
+	for (Module* m : game.m_station.modules) {
+		if (m->build_progress < 1) {
+			module = m;
+			break;
+		}
+	}
+	game.m_selected_module = module;
+	return *module;
+}
+
+void StationBenchmarks::benchmarkLuaApiCosts(Context& ctx) {
+	selectBusyModule(ctx.game);
+	benchmarkLuaApi(ctx.game, ctx.report, 1000);
+}
+
+void StationBenchmarks::benchmarkGUI(Context& ctx) {
+	GameModule& game = ctx.game;
+	Module& module = selectBusyModule(game);
+	ctx.report.measure("gui.selectModule", 10, [&](){ game.selectModule(module); });
+
+	// soak, callbacks and GUI memory must not grow with repeated selections
+	const size_t gui_memory = game.m_memory.gui.live;
+	const u32 callbacks = game.m_button_callbacks.size();
+	for (u32 i = 0; i < 1000; ++i) game.selectModule(module);
+	ctx.report.value("gui.callbacks_growth_1000_selections", double(game.m_button_callbacks.size()) - callbacks);
+	ctx.report.value("gui.memory_growth_1000_selections", double(game.m_memory.gui.live) - double(gui_memory));
+	game.signal("close_module_ui");
+	game.flushCommands();
+}
+
+// camera flying along the station, half of the time far away from it
+void StationBenchmarks::benchmarkStreaming(Context& ctx) {
+	GameModule& game = ctx.game;
+	ModuleStreaming& streaming = game.m_streaming;
+	u32 frame = 0;
+	ctx.report.measure("streaming.update", 100, [&](){
+		++frame;
+		const Array<Module*>& modules = game.m_station.modules;
+		streaming.has_viewpoint = true;
+		streaming.viewpoint = game.m_world.getLocalTransform(modules[frame % modules.size()]->entity).pos;
+		if (frame & 1) streaming.viewpoint.y += 10'000;
+		game.updateStreaming();
+	});
+	streaming.has_viewpoint = false;
+}
+
+// the same station spawned from its template and built piece by piece
+void StationBenchmarks::benchmarkTemplates(Context& ctx) {
+	GameModule& game = ctx.game;
+	StationTemplate tpl(game.m_allocator);
+	game.captureTemplate(tpl);
+	ctx.report.measure("template.instantiate", 3, [&](){ game.instantiateTemplate(tpl); });
+	ctx.report.measure("template.generate_incremental", 3, [&](){ generateStation(game, ctx.seed, ctx.size, 0); });
+}
+
+// 100k timers spread over a day of game time, fired at 1 s steps and in one jump
+void StationBenchmarks::benchmarkScheduler(Context& ctx) {
+	BenchmarkReport& report = ctx.report;
+	TimingWheel wheel(ctx.game.m_allocator);
+	const u32 events = 100'000;
+	const u32 day = u32(24 * 3600 / GameModule::TIMER_TICK);
+	const double to_ns = 1e9 / os::Timer::getFrequency();
+	Rng rng(ctx.seed);
+	u64 fired = 0;
+	auto fire = [&](u64 payload){ fired += payload; };
+	auto fill = [&](){
+		for (u32 i = 0; i < events; ++i) wheel.schedule(wheel.now() + 1 + rng.next(day), i);
+	};
+
+	u64 t = os::Timer::getRawTimestamp();
+	fill();
+	report.value("scheduler.schedule_ns_per_event", (os::Timer::getRawTimestamp() - t) * to_ns / events);
+
+	t = os::Timer::getRawTimestamp();
+	const u32 step = u32(1 / GameModule::TIMER_TICK);
+	for (u32 tick = step; tick <= day + step; tick += step) wheel.advance(tick, fire);
+	report.value("scheduler.fire_stepped_ns_per_event", (os::Timer::getRawTimestamp() - t) * to_ns / events);
+	ASSERT(wheel.size() == 0);
+
+	fill();
+	t = os::Timer::getRawTimestamp();
+	wheel.advance(wheel.now() + day + 1, fire);
+	report.value("scheduler.fire_jump_ns_per_event", (os::Timer::getRawTimestamp() - t) * to_ns / events);
+
+	Array<TimingWheel::Handle> handles(ctx.game.m_allocator);
+	handles.reserve(events);
+	for (u32 i = 0; i < events; ++i) handles.push(wheel.schedule(wheel.now() + 1 + rng.next(day), i));
+	t = os::Timer::getRawTimestamp();
+	for (const TimingWheel::Handle& h : handles) wheel.cancel(h);
+	report.value("scheduler.cancel_ns_per_event", (os::Timer::getRawTimestamp() - t) * to_ns / events);
+	ASSERT(wheel.size() == 0);
+}
+
+// needs do not depend on the station, only on the crew count
+void StationBenchmarks::benchmarkNeeds(Context& ctx) {
+	CrewNeeds needs(ctx.game.m_allocator);
+	needs.resize(100'000);
+	ctx.report.crew = needs.size();
+	const CrewNeeds::Rates rates = GameModule::getNeedsRates(DT, true, true, needs.size());
+	ctx.report.measure("crew.needs_100k", 100, [&](){ needs.update(rates); });
+}
+
+// 100x100 grid of modules linked to their 4 neighbours, one minute of game time per step
+void StationBenchmarks::benchmarkThermal(Context& ctx) {
+	ThermalField thermal(ctx.game.m_allocator);
+	const u32 side = 100;
+	thermal.resize(side * side);
+	for (u32 i = 0; i < side * side; ++i) {
+		const u32 x = i % side;
+		const u32 y = i / side;
+		if (x > 0) thermal.setLink(i, 0, i - 1);
+		if (x + 1 < side) thermal.setLink(i, 1, i + 1);
+		if (y > 0) thermal.setLink(i, 2, i - side);
+		if (y + 1 < side) thermal.setLink(i, 3, i + side);
+		thermal.getHeat()[i] = (i % 7) * 50.f;
+	}
+	ctx.report.modules = thermal.size();
+	ctx.report.measure("thermal.step_10k", 100, [&](){ thermal.step(ThermalField::MAX_SUBSTEP); });
+}
+
+void StationBenchmarks::benchmarkSolar(Context& ctx) {
+	SolarPanels solar(ctx.game.m_allocator);
+	Rng rng(ctx.seed);
+	for (u32 i = 0; i < 4096; ++i) {
+		const Vec3 normal = normalize(Vec3(rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f));
+		solar.push(normal, 240);
+	}
+	u32 phase = 0;
+	ctx.report.measure("solar.kernel_4096_panels", 1000, [&](){ solar.evaluate(phase++ % (SolarPanels::PHASES / 4)); }); // sunlit quarter
+	// a whole orbit per call, after the first orbit everything is cached
+	float angle = 0;
+	ctx.report.measure("solar.time_warp_4096_panels", 1000, [&](){
+		angle += 2 * PI;
+		solar.getOutput(angle - 2 * PI, angle);
+	});
+}
+
+// in the order they run, some leave the station changed for the next one, e.g. maintenance skips a week
+const StationBenchmarks::Benchmark StationBenchmarks::STATION_BENCHMARKS[] = {
+	{ "tick", benchmarkTick },
+	{ "orbit", benchmarkOrbit },
+	{ "autosave", benchmarkAutosave },
+	{ "undo", benchmarkUndo },
+	{ "expeditions", benchmarkExpeditions },
+	{ "maintenance", benchmarkMaintenance },
+	{ "replication", benchmarkReplication },
+	{ "research", benchmarkResearch },
+	{ "pathfinding", benchmarkPathfinding },
+	{ "commands", benchmarkCommands },
+	{ "lua_api", benchmarkLuaApiCosts },
+	{ "gui", benchmarkGUI },
+	{ "streaming", benchmarkStreaming },
+	{ "template", benchmarkTemplates },
 };
 
+const StationBenchmarks::Benchmark StationBenchmarks::STANDALONE_BENCHMARKS[] = {
+	{ "scheduler", benchmarkScheduler },
+	{ "needs", benchmarkNeeds },
+	{ "thermal", benchmarkThermal },
+	{ "solar", benchmarkSolar },
+};
+
+bool StationBenchmarks::run(GameModule& game, u32 seed, Span<const u32> sizes, const char* path, bool update_baseline) {
+	PROFILE_FUNCTION();
+	if (!game.areModulePrefabsReady()) {
+		logError("Module prefabs are not loaded yet, can not run benchmarks");
+		return false;
+	}
+	// the player's station comes back once the generated ones are measured
+	OutputMemoryStream station(game.m_allocator);
+	game.captureSnapshot(station);
+	BenchmarkReport report(game.m_allocator);
+	game.m_time_multiplier = 1;
+
+	for (u32 size : sizes) {
+		generateStation(game, seed, size, size / 2 + 3);
+		Context ctx = { game, report, seed, size, path };
+		for (const Benchmark& b : STATION_BENCHMARKS) {
+			report.modules = game.m_station.modules.size();
+			report.crew = game.m_station.crew.size();
+			b.run(ctx);
+		}
+	}
+
+	Context ctx = { game, report, seed, 0, path };
+	for (const Benchmark& b : STANDALONE_BENCHMARKS) {
+		report.modules = 0;
+		report.crew = 0;
+		b.run(ctx);
+	}
+
+	game.restoreStation(station);
+	if (!report.save(path)) return false;
+	logInfo("Benchmark results saved to ", path);
+	return checkLuaApiBaseline(game, report, update_baseline) == 0;
+}
+
+u64 StationBenchmarks::getNativeAllocations(const GameModule& game) {
+	u64 res = 0;
+	for (const TrackingAllocator* a : game.m_memory.all) res += a->allocations;
+	return res;
+}
+
+u64 StationBenchmarks::getLuaMemory(lua_State* L) { return u64(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0); }
+
+// Calls each Game.* closure the same way scripts do and adds its time, Lua garbage and game allocations
+// per call to the report. Only the closure itself is measured, not the lookup and the arguments.
+void StationBenchmarks::benchmarkLuaApi(GameModule& game, BenchmarkReport& report, u32 iterations) {
+	PROFILE_FUNCTION();
+	// left out are closures replacing or rebuilding the station, doing file I/O or benchmarking something themselves,
+	// and setters, which only store their arguments
+	static const LuaApiCall calls[] = {
+		{ "getBuildProgress", [](GameModule&, lua_State*) { return 0; } },
+		{ "signal", [](GameModule&, lua_State* L) { lua_pushstring(L, "time_1x"); return 1; } },
+		{ "getStationStats", [](GameModule&, lua_State*) { return 0; } },
+		{ "getStatsHistory", [](GameModule&, lua_State* L) {
+			lua_pushstring(L, "power_prod");
+			lua_pushnumber(L, 60);
+			return 2;
+		} },
+		{ "getStatsGraph", [](GameModule&, lua_State* L) {
+			lua_pushstring(L, "power_prod");
+			lua_pushinteger(L, 0);
+			lua_pushinteger(L, 60);
+			return 3;
+		} },
+		{ "getModule", [](GameModule& game, lua_State* L) { LuaWrapper::push(L, game.m_selected_module->entity); return 1; } },
+		{ "getBlueprints", [](GameModule&, lua_State*) { return 0; } },
+		{ "getCrew", [](GameModule&, lua_State*) { return 0; } },
+		{ "getResearch", [](GameModule&, lua_State*) { return 0; } },
+		{ "getExpeditions", [](GameModule&, lua_State*) { return 0; } },
+		{ "getSupplyShips", [](GameModule&, lua_State*) { return 0; } },
+		{ "getMaintenanceTasks", [](GameModule&, lua_State*) { return 0; } },
+		{ "getReplicationStats", [](GameModule&, lua_State*) { return 0; } },
+		{ "getMemoryStats", [](GameModule&, lua_State*) { return 0; } },
+		{ "getScriptStats", [](GameModule&, lua_State*) { return 0; } },
+		{ "getStateHash", [](GameModule&, lua_State*) { return 0; } },
+		{ "assignBuilder", [](GameModule& game, lua_State* L) {
+			LuaWrapper::push(L, game.m_selected_module->id);
+			LuaWrapper::push(L, game.m_station.crew[0].id);
+			return 2;
+		} },
+		{ "onGUIEvent", [](GameModule&, lua_State* L) { lua_pushstring(L, "time_1x"); return 1; } },
+		{ "getStreamingStats", [](GameModule&, lua_State*) { return 0; } },
+		{ "getOrbitFrameStats", [](GameModule&, lua_State*) { return 0; } },
+		{ "getAutosaveStats", [](GameModule&, lua_State*) { return 0; } },
+		{ "getUndoStats", [](GameModule&, lua_State*) { return 0; } },
+	};
+	lua_State* L = game.m_game.m_engine.getState();
+	const double to_ns = 1e9 / os::Timer::getFrequency();
+	const CrewMember builder = game.m_station.crew[0]; // assignBuilder reassigns it
+
+	// the collector must not run in the middle of a call, it would free what we are counting
+	lua_gc(L, LUA_GCCOLLECT, 0);
+	lua_gc(L, LUA_GCSTOP, 0);
+	for (const LuaApiCall& call : calls) {
+		// one unmeasured call first, one-time costs like lazily built caches or interned strings are not per call
+		lua_getglobal(L, "Game"); // [Game]
+		lua_getfield(L, -1, call.name); // [Game, fn]
+		if (lua_pcall(L, call.push_args(game, L), 1, 0) != 0) logError(lua_tostring(L, -1)); // [Game, result]
+		lua_pop(L, 2); // []
+		game.flushCommands();
+
+		u64 ticks = 0;
+		u64 lua_bytes = 0;
+		u64 allocations = 0;
+		for (u32 i = 0; i < iterations; ++i) {
+			lua_getglobal(L, "Game"); // [Game]
+			lua_getfield(L, -1, call.name); // [Game, fn]
+			const int nargs = call.push_args(game, L); // [Game, fn, args...]
+
+			const u64 allocations_before = getNativeAllocations(game);
+			const u64 lua_memory = getLuaMemory(L);
+			const u64 start = os::Timer::getRawTimestamp();
+			const int res = lua_pcall(L, nargs, 1, 0); // [Game, result]
+			ticks += os::Timer::getRawTimestamp() - start;
+			lua_bytes += maximum(getLuaMemory(L), lua_memory) - lua_memory;
+			allocations += getNativeAllocations(game) - allocations_before;
+
+			if (res != 0) logError(lua_tostring(L, -1));
+			lua_pop(L, 2); // []
+			game.flushCommands(); // signal and onGUIEvent only queue
+			if (i % 64 == 63) lua_gc(L, LUA_GCCOLLECT, 0); // keep the garbage of big stations bounded
+		}
+
+		report.value(StaticString<64>("lua_api.", call.name, ".ns_per_call").data, ticks * to_ns / iterations);
+		report.value(StaticString<64>("lua_api.", call.name, ".lua_bytes_per_call").data, double(lua_bytes) / iterations);
+		report.value(StaticString<64>("lua_api.", call.name, ".native_allocs_per_call").data, double(allocations) / iterations);
+	}
+	lua_gc(L, LUA_GCRESTART, 0);
+	lua_gc(L, LUA_GCCOLLECT, 0);
+
+	game.m_station.crew[0] = builder;
+}
+
+// Compares the Lua API entries of `report` to the checked-in baseline and returns the number of failures:
+// regressions and entries the baseline does not have, e.g. new closures or other station sizes.
+// Until a baseline is recorded there is nothing to compare to and the check passes with a warning.
+// `update` replaces the baseline instead.
+u32 StationBenchmarks::checkLuaApiBaseline(GameModule& game, const BenchmarkReport& report, bool update) {
+	FileSystem& fs = game.m_game.m_engine.getFileSystem();
+	if (update) {
+		OutputMemoryStream blob(game.m_allocator);
+		for (const BenchmarkReport::Entry& e : report.entries) {
+			if (!e.is_value || !startsWith(e.name, "lua_api.")) continue;
+			char line[256];
+			BenchmarkReport::format(e, line);
+			blob.write(line, stringLength(line));
+		}
+		if (!fs.saveContentSync(Path(LUA_API_BASELINE), Span(blob.data(), (u32)blob.size()))) {
+			logError("Failed to write ", LUA_API_BASELINE);
+		}
+		else logInfo("Lua API baseline saved to ", LUA_API_BASELINE);
+		return 0;
+	}
+
+	OutputMemoryStream content(game.m_allocator);
+	if (!fs.getContentSync(Path(LUA_API_BASELINE), content)) {
+		logWarning(LUA_API_BASELINE, " not found, Lua API costs are not checked; record it by running the benchmarks with update_baseline");
+		return 0;
+	}
+	BenchmarkReport baseline(game.m_allocator);
+	baseline.loadValues(Span(content.data(), (u32)content.size()));
+
+	u32 regressions = 0;
+	u32 missing = 0;
+	u32 checked = 0;
+	for (const BenchmarkReport::Entry& e : report.entries) {
+		if (!e.is_value || !startsWith(e.name, "lua_api.")) continue;
+		const BenchmarkReport::Entry* base = baseline.findValue(e.name, e.modules, e.crew);
+		if (!base) {
+			logError(e.name, " with ", e.modules, " modules is not in the baseline");
+			++missing;
+			continue;
+		}
+
+		for (const auto& metric : LUA_API_METRICS) {
+			if (!endsWith(e.name, metric.suffix)) continue;
+			++checked;
+			// values are saved with 3 decimals
+			if (e.value > base->value * (1 + metric.tolerance) + 0.0005) {
+				logError(e.name, " with ", e.modules, " modules regressed from ", float(base->value), " to ", float(e.value));
+				++regressions;
+			}
+		}
+	}
+	logInfo("Checked ", checked, " Lua API costs against ", LUA_API_BASELINE, ", ", regressions, " regressions, ", missing, " missing");
+	return regressions + missing;
+}
+
+// Game.generateStation(seed, modules, crew) -> bool, the player's station is kept until Game.restoreStation
+int StationBenchmarks::lua_generateStation(lua_State* L) {
+	const u32 seed = LuaWrapper::checkArg<u32>(L, 1);
+	const u32 modules_count = LuaWrapper::checkArg<u32>(L, 2);
+	const u32 crew_count = LuaWrapper::checkArg<u32>(L, 3);
+	GameModule* game = GameModule::getClosureScene(L);
+	if (!game) return 0;
+
+	// a second generated station replaces the first one, not the player's
+	const bool stash = game->m_player_station.empty();
+	if (stash) game->captureSnapshot(game->m_player_station);
+	const bool res = generateStation(*game, seed, modules_count, crew_count);
+	if (!res && stash) game->m_player_station.clear();
+	lua_pushboolean(L, res);
+	return 1;
+}
+
+// Game.restoreStation() -> bool, brings back the station replaced by Game.generateStation
+int StationBenchmarks::lua_restoreStation(lua_State* L) {
+	GameModule* game = GameModule::getClosureScene(L);
+	if (!game) return 0;
+
+	if (game->m_player_station.empty()) {
+		lua_pushboolean(L, false);
+		return 1;
+	}
+	InputMemoryStream blob(game->m_player_station);
+	const bool res = game->restoreSnapshot(blob);
+	game->m_player_station.clear();
+	lua_pushboolean(L, res);
+	return 1;
+}
+
+// Game.runBenchmarks(seed, path, {sizes...} [, update_baseline])
+int StationBenchmarks::lua_runBenchmarks(lua_State* L) {
+	const u32 seed = LuaWrapper::checkArg<u32>(L, 1);
+	const char* path = LuaWrapper::checkArg<const char*>(L, 2);
+	LuaWrapper::checkTableArg(L, 3);
+	GameModule* game = GameModule::getClosureScene(L);
+	if (!game) return 0;
+
+	u32 sizes[16];
+	u32 count = 0;
+	for (;; ++count) {
+		lua_rawgeti(L, 3, count + 1);
+		if (!lua_isnumber(L, -1)) {
+			lua_pop(L, 1);
+			break;
+		}
+		if (count == lengthOf(sizes)) return luaL_error(L, "at most %d sizes can be benchmarked", (int)lengthOf(sizes));
+		sizes[count] = (u32)lua_tonumber(L, -1);
+		lua_pop(L, 1);
+	}
+
+	bool update_baseline = false;
+	if (lua_gettop(L) > 3) update_baseline = LuaWrapper::checkArg<bool>(L, 4);
+	lua_pushboolean(L, run(*game, seed, Span(sizes, count), path, update_baseline));
+	return 1;
+}
+
+void StationBenchmarks::registerLuaAPI(lua_State* L, GameModule& game) {
+	LuaWrapper::createSystemClosure(L, "Game", &game, "generateStation", lua_generateStation);
+	LuaWrapper::createSystemClosure(L, "Game", &game, "restoreStation", lua_restoreStation);
+	LuaWrapper::createSystemClosure(L, "Game", &game, "runBenchmarks", lua_runBenchmarks);
+}
+
+
 void Game::createModules(World& world) {
 	IAllocator& allocator = m_engine.getAllocator();
 	UniquePtr<GameModule> module = UniquePtr<GameModule>::create(allocator, *this, world);